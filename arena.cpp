@@ -0,0 +1,118 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----EventArena Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the EventArena class, a monotonic allocator
+  that events can be placed in so that they are all freed at once.
+*/
+
+#include "arena.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <functional>
+
+namespace midi
+{
+
+  //Rounds a size up to a multiple of the alignment
+  static std::size_t roundUp(std::size_t size)
+  {
+    return (size + EventArena::ALIGN - 1) & ~(EventArena::ALIGN - 1);
+  }
+
+  //Constructor, allocates nothing yet
+  EventArena::EventArena(std::size_t blockSize) :
+    pos_(NULL), remaining_(0), blockSize_(roundUp(blockSize)), used_(0) {}
+
+  //Destructor
+  EventArena::~EventArena()
+  {
+    release();
+  }
+
+  //Hands out the next size bytes
+  void* EventArena::allocate(std::size_t size)
+  {
+    size = roundUp(size == 0 ? 1 : size);
+    if (size > remaining_) grow(size);
+
+    void* ret = pos_;
+    pos_ += size;
+    remaining_ -= size;
+    used_ += size;
+    return ret;
+  }
+
+  //Copies bytes into the arena
+  std::uint8_t* EventArena::copy(const std::uint8_t* data, std::size_t size)
+  {
+    std::uint8_t* ret = static_cast<std::uint8_t*>(allocate(size));
+    if (size > 0) std::memcpy(ret, data, size);
+    return ret;
+  }
+
+  //Makes sure the next bytes of allocations fit in one block
+  void EventArena::reserve(std::size_t bytes)
+  {
+    bytes = roundUp(bytes);
+    if (bytes > remaining_) grow(bytes);
+  }
+
+  //Recent allocations are in the used part of the newest block. Otherwise the
+  //block starting at or before the pointer is found and its end checked.
+  bool EventArena::owns(const void* ptr) const
+  {
+    if (block_.empty()) return false;
+    const std::uint8_t* p = static_cast<const std::uint8_t*>(ptr);
+    std::less<const std::uint8_t*> less;
+    if (!less(p, block_.back()) && less(p, pos_)) return true;
+
+    std::map<const std::uint8_t*, std::size_t>::const_iterator it =
+      blockBytes_.upper_bound(p);
+    if (it == blockBytes_.begin()) return false;
+    --it;
+    return less(p, it->first + it->second);
+  }
+
+  //Frees every block
+  void EventArena::release()
+  {
+    for (std::size_t i = 0; i < block_.size(); i++)
+      {
+        std::free(block_[i]);
+      }
+    block_.clear();
+    blockBytes_.clear();
+    pos_ = NULL;
+    remaining_ = 0;
+    used_ = 0;
+  }
+
+  //Starts a new block, abandoning the rest of the current one
+  void EventArena::grow(std::size_t size)
+  {
+    if (size < blockSize_) size = blockSize_;
+    std::uint8_t* block = static_cast<std::uint8_t*>(std::malloc(size));
+    if (block == NULL) throw std::bad_alloc();
+    block_.push_back(block);
+    blockBytes_[block] = size;
+    pos_ = block;
+    remaining_ = size;
+  }
+
+} //Namespace
+
+//Placement of objects in an arena
+void* operator new(std::size_t size, midi::EventArena & arena)
+{
+  return arena.allocate(size);
+}
+
+//Only called if a constructor throws; the memory is reclaimed with the arena
+void operator delete(void*, midi::EventArena &) {}
@@ -0,0 +1,74 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----EventArena Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the EventArena class, a monotonic allocator that
+  events can be placed in so that they are all freed at once.
+*/
+
+#ifndef _arena_hpp_
+#define _arena_hpp_
+
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+namespace midi
+{
+
+  class EventArena
+  {
+  public:
+    //Every allocation is rounded up to this and aligned to it
+    static const std::size_t ALIGN = alignof(std::max_align_t);
+
+    EventArena(std::size_t blockSize = 65536);
+    ~EventArena();
+
+    //Allocation. Nothing is freed until release or destruction.
+    void* allocate(std::size_t size);
+    std::uint8_t* copy(const std::uint8_t* data, std::size_t size);
+
+    //Makes sure the next bytes of allocations fit in one block
+    void reserve(std::size_t bytes);
+
+    //Frees everything at once. Objects in the arena are not destroyed.
+    void release();
+
+    //Bytes handed out so far
+    std::size_t used() const {return used_;}
+
+    //Whether an object was allocated from this arena. The block being filled
+    //is checked first, then the rest by address in O(log blocks).
+    bool owns(const void* ptr) const;
+
+  private:
+    //Arenas own their memory and can't be copied
+    EventArena(const EventArena&);
+    EventArena& operator=(const EventArena&);
+
+    //Starts a new block of at least the given size
+    void grow(std::size_t size);
+
+    std::vector<std::uint8_t*> block_;
+
+    //Size of each block, by address
+    std::map<const std::uint8_t*, std::size_t> blockBytes_;
+    std::uint8_t* pos_;
+    std::size_t remaining_;
+    std::size_t blockSize_;
+    std::size_t used_;
+  };
+
+} //Namespace
+
+//Placement of objects in an arena: new (arena) T(...)
+void* operator new(std::size_t size, midi::EventArena & arena);
+void operator delete(void* ptr, midi::EventArena & arena);
+
+#endif
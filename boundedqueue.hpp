@@ -0,0 +1,104 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----BoundedQueue Class Template-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the BoundedQueue class template, a fixed-size queue which any number
+  of threads can push to and pop from without locks.
+*/
+
+#ifndef _boundedqueue_hpp_
+#define _boundedqueue_hpp_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace midi
+{
+
+  //Each slot carries a sequence number saying whether it is ready to be
+  //written or read on the current lap around the ring, so a push or pop is a
+  //single compare and swap. Nothing is allocated after construction.
+  template <typename T, std::size_t Capacity>
+  class BoundedQueue
+  {
+  public:
+    BoundedQueue() : head_(0), tail_(0)
+    {
+      for (std::size_t i = 0; i < Capacity; i++)
+        {
+          slot_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    //Returns false if the queue is full
+    bool push(const T & value)
+    {
+      std::size_t pos = tail_.load(std::memory_order_relaxed);
+      for (;;)
+        {
+          Slot & slot = slot_[pos % Capacity];
+          std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+          std::intptr_t diff = std::intptr_t(seq) - std::intptr_t(pos);
+          if (diff == 0)
+            {
+              if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                  slot.value = value;
+                  slot.sequence.store(pos + 1, std::memory_order_release);
+                  return true;
+                }
+            }
+          else if (diff < 0) return false;
+          else pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    //Returns false if the queue is empty
+    bool pop(T & value)
+    {
+      std::size_t pos = head_.load(std::memory_order_relaxed);
+      for (;;)
+        {
+          Slot & slot = slot_[pos % Capacity];
+          std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+          std::intptr_t diff = std::intptr_t(seq) - std::intptr_t(pos + 1);
+          if (diff == 0)
+            {
+              if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                  value = slot.value;
+                  slot.sequence.store(pos + Capacity, std::memory_order_release);
+                  return true;
+                }
+            }
+          else if (diff < 0) return false;
+          else pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    //Queues are shared between threads and can't be copied
+    BoundedQueue(const BoundedQueue&);
+    BoundedQueue& operator=(const BoundedQueue&);
+
+    struct Slot
+    {
+      std::atomic<std::size_t> sequence;
+      T value;
+    };
+
+    Slot slot_[Capacity];
+
+    //Kept on separate cache lines so producers and consumers don't collide
+    alignas(64) std::atomic<std::size_t> head_;
+    alignas(64) std::atomic<std::size_t> tail_;
+  };
+
+} //Namespace
+
+#endif
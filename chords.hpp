@@ -7,28 +7,97 @@
   austonst@gmail.com
 
   Contains functions to be able to easily use or reference common chords.
+  Everything here can be evaluated at compile time.
 */
 
 #ifndef _chords_hpp_
 #define _chords_hpp_
 
 #include "note.hpp"
+#include "scales.hpp"
 
 namespace midi
 {
 
-  Chord majTriad(const Note root);
-  Chord minTriad(const Note root);
-  Chord dimTriad(const Note root);
-  Chord augTriad(const Note root);
-
-  Chord majSeventh(const Note root);
-  Chord minSeventh(const Note root);
-  Chord domSeventh(const Note root);
-  Chord dimSeventh(const Note root);
-  Chord halfDimSeventh(const Note root);
-  Chord minMajSeventh(const Note root);
-  Chord augMajSeventh(const Note root);
+  //Returns the major triadic chord with the given root
+  constexpr Chord majTriad(const Note root)
+  {
+    return Chord(root, root+4, root+7);
+  }
+
+  //Returns the minor triadic chord with the given root
+  constexpr Chord minTriad(const Note root)
+  {
+    return Chord(root, root+3, root+7);
+  }
+
+  //Returns the diminished triadic chord with the given root
+  constexpr Chord dimTriad(const Note root)
+  {
+    return Chord(root, root+3, root+6);
+  }
+
+  //Returns the augmented triadic chord with the given root
+  constexpr Chord augTriad(const Note root)
+  {
+    return Chord(root, root+4, root+8);
+  }
+
+  //Returns the major seventh chord with the given root
+  constexpr Chord majSeventh(const Note root)
+  {
+    return Chord(root, root+4, root+7, root+11);
+  }
+
+  //Returns the minor seventh chord with the given root
+  constexpr Chord minSeventh(const Note root)
+  {
+    return Chord(root, root+3, root+7, root+10);
+  }
+
+  //Returns the dominant seventh chord with the given root
+  constexpr Chord domSeventh(const Note root)
+  {
+    return Chord(root, root+4, root+7, root+10);
+  }
+
+  //Returns the diminished seventh chord with the given root
+  constexpr Chord dimSeventh(const Note root)
+  {
+    return Chord(root, root+3, root+6, root+9);
+  }
+
+  //Returns the half-diminished seventh chord with the given root
+  constexpr Chord halfDimSeventh(const Note root)
+  {
+    return Chord(root, root+3, root+6, root+10);
+  }
+
+  //Returns the minor major seventh chord with the given root
+  constexpr Chord minMajSeventh(const Note root)
+  {
+    return Chord(root, root+3, root+7, root+11);
+  }
+
+  //Returns the augmented major seventh chord with the given root
+  constexpr Chord augMajSeventh(const Note root)
+  {
+    return Chord(root, root+4, root+8, root+11);
+  }
+
+  //Returns the triad built on the given degree of the scale based at the key
+  constexpr Chord scaleTriad(const Scale & scale, Note key, int num)
+  {
+    return Chord(scaleNote(scale, key, num), scaleNote(scale, key, num+2),
+                 scaleNote(scale, key, num+4));
+  }
+
+  //Returns the seventh chord built on the given degree of the scale based at the key
+  constexpr Chord scaleSeventh(const Scale & scale, Note key, int num)
+  {
+    return Chord(scaleNote(scale, key, num), scaleNote(scale, key, num+2),
+                 scaleNote(scale, key, num+4), scaleNote(scale, key, num+6));
+  }
   
 } //Namespace
 
@@ -0,0 +1,344 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----CompactTrack Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the CompactTrack class, a track storing its
+  events as fixed-size records in contiguous memory.
+*/
+
+#include "compacttrack.hpp"
+
+#include <cstring>
+#include <utility>
+
+namespace midi
+{
+
+  //Number of parameter bytes following a channel status byte
+  static std::size_t channelParams(std::uint8_t status)
+  {
+    return (status >> 4 == 0x0C || status >> 4 == 0x0D) ? 1 : 2;
+  }
+
+  //Writes a record up to its meta or SysEx data, which the caller copies
+  static std::uint8_t* encodeRecord(const CompactEvent & ev, std::uint8_t* out)
+  {
+    out = VarLength(ev.deltaTime).encodeInto(out);
+    *out++ = ev.status;
+    if (ev.status >= 0xF0)
+      {
+        if (ev.status == 0xFF) *out++ = ev.param1;
+        return VarLength(ev.length).encodeInto(out);
+      }
+    *out++ = ev.param1;
+    if (channelParams(ev.status) == 2) *out++ = ev.param2;
+    return out;
+  }
+
+  //Constructors
+  CompactTrack::CompactTrack() : size_(8) {}
+
+  CompactTrack::CompactTrack(const EventTrack & track) : size_(8)
+  {
+    event_.reserve(track.event().size());
+    for (std::size_t i = 0; i < track.event().size(); i++)
+      {
+        add(*track.event()[i]);
+      }
+  }
+
+  CompactTrack::CompactTrack(const Track & track) : size_(8)
+  {
+    std::vector<std::uint8_t> data = track.data();
+    if (data.size() < 8 || !read(&data[0] + 8, &data[0] + data.size())) clear();
+  }
+
+  //Clears all events and their data
+  void CompactTrack::clear()
+  {
+    event_.clear();
+    pool_.clear();
+    size_ = 8;
+  }
+
+  //Makes room ahead of time
+  void CompactTrack::reserve(std::size_t events, std::size_t poolBytes)
+  {
+    event_.reserve(events);
+    pool_.reserve(poolBytes);
+  }
+
+  //Adds a record and its encoded size
+  void CompactTrack::push(const CompactEvent & ev)
+  {
+    event_.push_back(ev);
+    size_ += eventSize(event_.size() - 1);
+  }
+
+  //Adds a copy of any event, packing its fields straight into a record
+  bool CompactTrack::add(const Event & ev)
+  {
+    const ChannelEvent* channel = dynamic_cast<const ChannelEvent*>(&ev);
+    if (channel != NULL)
+      {
+        //Parameters have to be data bytes, as when reading
+        std::uint8_t param2 = (channelParams(channel->status()) == 2) ? channel->param2() : 0;
+        if ((channel->param1() | param2) & 0x80) return false;
+        return addChannel(ev.dt(), channel->status(), channel->param1(), param2);
+      }
+
+    const MetaEvent* meta = dynamic_cast<const MetaEvent*>(&ev);
+    if (meta != NULL)
+      {
+        addMeta(ev.dt(), meta->metaType(), meta->payload().begin(), meta->payload().size());
+        return true;
+      }
+
+    const SysExEvent* sysEx = dynamic_cast<const SysExEvent*>(&ev);
+    if (sysEx != NULL)
+      {
+        addSysEx(ev.dt(), sysEx->sysExType(), sysEx->payload().begin(), sysEx->payload().size());
+        return true;
+      }
+
+    return false;
+  }
+
+  //Adds a channel event, refusing status bytes of other kinds
+  bool CompactTrack::addChannel(std::uint32_t deltaTime, std::uint8_t status,
+                                std::uint8_t param1, std::uint8_t param2)
+  {
+    if (status < 0x80 || status >= 0xF0) return false;
+
+    CompactEvent ev;
+    ev.deltaTime = deltaTime;
+    ev.status = status;
+    ev.param1 = param1;
+    ev.param2 = (channelParams(status) == 2) ? param2 : 0;
+    ev.offset = 0;
+    ev.length = 0;
+    push(ev);
+    return true;
+  }
+
+  //Adds a meta event, copying its data into the pool
+  void CompactTrack::addMeta(std::uint32_t deltaTime, std::uint8_t type,
+                             const std::uint8_t* data, std::size_t length)
+  {
+    CompactEvent ev;
+    ev.deltaTime = deltaTime;
+    ev.status = 0xFF;
+    ev.param1 = type;
+    ev.param2 = 0;
+    ev.offset = pool_.size();
+    ev.length = length;
+    pool_.insert(pool_.end(), data, data + length);
+    push(ev);
+  }
+
+  //Adds a SysEx event, copying its data into the pool
+  void CompactTrack::addSysEx(std::uint32_t deltaTime, std::uint8_t type,
+                              const std::uint8_t* data, std::size_t length)
+  {
+    CompactEvent ev;
+    ev.deltaTime = deltaTime;
+    ev.status = type;
+    ev.param1 = 0;
+    ev.param2 = 0;
+    ev.offset = pool_.size();
+    ev.length = length;
+    pool_.insert(pool_.end(), data, data + length);
+    push(ev);
+  }
+
+  //Decodes the contents of an MTrk chunk straight into records
+  bool CompactTrack::read(const std::uint8_t* pos, const std::uint8_t* end)
+  {
+    std::uint8_t runningStatus = 0;
+    while (pos != end)
+      {
+        std::uint32_t deltaTime;
+        if (!readVarLength(pos, end, deltaTime)) return false;
+        if (pos == end) return false;
+
+        //Meta and SysEx events
+        std::uint8_t status = *pos;
+        if (status == 0xFF || status == 0xF0 || status == 0xF7)
+          {
+            pos++;
+            std::uint8_t type = 0;
+            if (status == 0xFF)
+              {
+                if (pos == end) return false;
+                type = *pos++;
+              }
+            std::uint32_t length;
+            if (!readVarLength(pos, end, length)) return false;
+            if (std::size_t(end - pos) < length) return false;
+            if (status == 0xFF) addMeta(deltaTime, type, pos, length);
+            else addSysEx(deltaTime, status, pos, length);
+            pos += length;
+            continue;
+          }
+
+        //Channel events, possibly using running status
+        if (status & 0x80)
+          {
+            if (status >= 0xF0) return false;
+            runningStatus = status;
+            pos++;
+          }
+        else
+          {
+            if (runningStatus == 0) return false;
+            status = runningStatus;
+          }
+        std::size_t params = channelParams(status);
+        if (std::size_t(end - pos) < params) return false;
+        std::uint8_t param1 = pos[0];
+        std::uint8_t param2 = (params == 2) ? pos[1] : 0;
+        if ((param1 | param2) & 0x80) return false;
+        addChannel(deltaTime, status, param1, param2);
+        pos += params;
+      }
+
+    return true;
+  }
+
+  //Note On returns the note, Note Off the note + 128, and anything else 256
+  std::uint16_t CompactTrack::getNote(std::size_t i) const
+  {
+    const CompactEvent & ev = event_[i];
+    if (ev.status >> 4 == 0x09) return ev.param1;
+    if (ev.status >> 4 == 0x08) return ev.param1 + 128;
+    return 256;
+  }
+
+  //Encoded size of one event
+  std::size_t CompactTrack::eventSize(std::size_t i) const
+  {
+    const CompactEvent & ev = event_[i];
+    std::size_t ret = VarLength::size(ev.deltaTime);
+    if (ev.status == 0xFF) return ret + 2 + VarLength::size(ev.length) + ev.length;
+    if (ev.status >= 0xF0) return ret + 1 + VarLength::size(ev.length) + ev.length;
+    return ret + 1 + channelParams(ev.status);
+  }
+
+  //Combines all of the event data along with the header
+  std::vector<std::uint8_t> CompactTrack::data() const
+  {
+    std::vector<std::uint8_t> out(size());
+    encodeInto(&out[0]);
+    return out;
+  }
+
+  //Streams the track, encoding records into a small buffer between writes
+  bool CompactTrack::write(ByteSink & sink) const
+  {
+    std::uint8_t buffer[4096];
+    std::uint8_t* out = encodeHeader(buffer);
+    for (std::size_t i = 0; i < event_.size(); i++)
+      {
+        const CompactEvent & ev = event_[i];
+        std::size_t eventSize = this->eventSize(i);
+
+        //Make room for it
+        if (std::size_t(out - buffer) + eventSize > sizeof(buffer))
+          {
+            if (!sink.write(buffer, out - buffer)) return false;
+            out = buffer;
+          }
+        out = encodeRecord(ev, out);
+
+        //Data too big for the buffer goes straight from the pool
+        if (eventSize > sizeof(buffer))
+          {
+            if (!sink.write(buffer, out - buffer)) return false;
+            if (!sink.write(&pool_[ev.offset], ev.length)) return false;
+            out = buffer;
+            continue;
+          }
+
+        if (ev.length > 0) std::memcpy(out, &pool_[ev.offset], ev.length);
+        out += ev.length;
+      }
+
+    return out == buffer || sink.write(buffer, out - buffer);
+  }
+
+  //Writes the track header
+  std::uint8_t* CompactTrack::encodeHeader(std::uint8_t* out) const
+  {
+    std::size_t trackSize = size()-8;
+    *out++ = 'M';
+    *out++ = 'T';
+    *out++ = 'r';
+    *out++ = 'k';
+    *out++ = trackSize >> 24;
+    *out++ = (trackSize >> 16)&0xFF;
+    *out++ = (trackSize >> 8)&0xFF;
+    *out++ = trackSize&0xFF;
+    return out;
+  }
+
+  //Encodes the header and every event directly into out
+  std::uint8_t* CompactTrack::encodeInto(std::uint8_t* out) const
+  {
+    out = encodeHeader(out);
+    for (std::size_t i = 0; i < event_.size(); i++)
+      {
+        const CompactEvent & ev = event_[i];
+        out = encodeRecord(ev, out);
+        if (ev.length > 0) std::memcpy(out, &pool_[ev.offset], ev.length);
+        out += ev.length;
+      }
+
+    return out;
+  }
+
+  //Conversion to EventTrack
+  EventTrack CompactTrack::toEvents() const
+  {
+    EventTrack track;
+    for (std::size_t i = 0; i < event_.size(); i++)
+      {
+        const CompactEvent & ev = event_[i];
+        const std::uint8_t* first = pool_.data() + ev.offset;
+        if (ev.status == 0xFF)
+          {
+            track.adopt(new RawMetaEvent(ev.deltaTime, ev.param1,
+                                         Payload(first, first + ev.length)));
+          }
+        else if (ev.status >= 0xF0)
+          {
+            track.adopt(new RawSysExEvent(ev.deltaTime, ev.status,
+                                          Payload(first, first + ev.length)));
+          }
+        else
+          {
+            track.adopt(makeChannelEvent(ev.deltaTime, ev.status, ev.param1, ev.param2));
+          }
+      }
+
+    return track;
+  }
+
+  //Clone function
+  Track* CompactTrack::clone() const
+  {
+    return new CompactTrack(*this);
+  }
+
+  //Moves the records and pool into a new track without copying them
+  Track* CompactTrack::moveClone()
+  {
+    CompactTrack* ct = new CompactTrack(std::move(*this));
+    clear();
+    return ct;
+  }
+
+} //Namespace
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----CompactTrack Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the CompactTrack class, a track storing its events as
+  fixed-size records in contiguous memory rather than as individual objects.
+*/
+
+#ifndef _compacttrack_hpp_
+#define _compacttrack_hpp_
+
+#include "track.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace midi
+{
+
+  //One event of a CompactTrack
+  struct CompactEvent
+  {
+    std::uint32_t deltaTime;
+
+    //Channel status byte, 0xFF for meta events, or 0xF0/0xF7 for SysEx events
+    std::uint8_t status;
+
+    //Channel event parameters. param1 holds the type of a meta event.
+    std::uint8_t param1;
+    std::uint8_t param2;
+
+    //Meta and SysEx data, as a range of the track's byte pool
+    std::uint32_t offset;
+    std::uint32_t length;
+  };
+
+  //A track the way MIDI percieves it, packed for fast traversal
+  class CompactTrack : public Track
+  {
+  public:
+    //Constructors
+    CompactTrack();
+    CompactTrack(const EventTrack & track);
+
+    //Reads any kind of track back from its encoding
+    //Stays empty if the encoding is malformed
+    explicit CompactTrack(const Track & track);
+
+    //Operations on the events
+    void clear();
+    std::size_t size() const {return size_;}
+    std::size_t count() const {return event_.size();}
+    void reserve(std::size_t events, std::size_t poolBytes = 0);
+
+    //Adding events
+    //add and addChannel return false if the event can't be stored
+    bool add(const Event & ev);
+    bool addChannel(std::uint32_t deltaTime, std::uint8_t status,
+                    std::uint8_t param1, std::uint8_t param2 = 0);
+    void addMeta(std::uint32_t deltaTime, std::uint8_t type,
+                 const std::uint8_t* data, std::size_t length);
+    void addSysEx(std::uint32_t deltaTime, std::uint8_t type,
+                  const std::uint8_t* data, std::size_t length);
+
+    //Appends the events in the contents of an MTrk chunk
+    //Returns false if it is malformed, keeping the events before the problem
+    bool read(const std::uint8_t* pos, const std::uint8_t* end);
+
+    //Per-event queries, matching those of Event
+    std::uint32_t dt(std::size_t i) const {return event_[i].deltaTime;}
+    std::uint16_t getNote(std::size_t i) const;
+    std::size_t eventSize(std::size_t i) const;
+    const std::uint8_t* payload(std::size_t i) const {return pool_.data() + event_[i].offset;}
+
+    //Accessor for read-only examination or debugging
+    const std::vector<CompactEvent> & event() const {return event_;}
+
+    //Implementation of Track::data, Track::write and Track::encodeInto
+    std::vector<std::uint8_t> data() const;
+    bool write(ByteSink & sink) const;
+    std::uint8_t* encodeInto(std::uint8_t* out) const;
+
+    //Convert to EventTrack
+    EventTrack toEvents() const;
+
+    //Clone functions
+    Track* clone() const;
+    Track* moveClone();
+
+  private:
+    //Writes the track header
+    std::uint8_t* encodeHeader(std::uint8_t* out) const;
+
+    //Adds a record and its encoded size
+    void push(const CompactEvent & ev);
+
+    std::vector<CompactEvent> event_;
+    std::vector<std::uint8_t> pool_;
+
+    //Size of the whole track in bytes, kept up to date on every addition
+    std::size_t size_;
+  };
+
+} //Namespace
+
+#endif
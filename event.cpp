@@ -11,6 +11,9 @@
 
 #include "event.hpp"
 
+#include <utility>
+#include <cstring>
+
 namespace midi
 {
 
@@ -26,35 +29,98 @@ namespace midi
     deltaTime_ = indt;
   }
 
-  //Channel event functions
-  std::vector<std::uint8_t> ChannelEvent::data() const
+  //Every event's data is its encoding
+  std::vector<std::uint8_t> Event::data() const
+  {
+    std::vector<std::uint8_t> out(size());
+    encodeInto(&out[0]);
+    return out;
+  }
+
+  //Appends the encoding to the end of out
+  void Event::encodeInto(std::vector<std::uint8_t> & out) const
   {
-    //Create the output vector
-    std::vector<std::uint8_t> out;
+    std::size_t start = out.size();
+    out.resize(start + size());
+    encodeInto(&out[start]);
+  }
+
+  //Other events cancel running status
+  std::size_t Event::runningSize(std::uint8_t & status) const
+  {
+    status = 0;
+    return size();
+  }
 
-    //Start adding things to it
+  std::uint8_t* Event::runningEncodeInto(std::uint8_t* out, std::uint8_t & status) const
+  {
+    status = 0;
+    return encodeInto(out);
+  }
+
+  std::vector<std::uint8_t> Event::runningData(std::uint8_t & status) const
+  {
+    std::uint8_t sizeStatus = status;
+    std::vector<std::uint8_t> out(runningSize(sizeStatus));
+    runningEncodeInto(&out[0], status);
+    return out;
+  }
+
+  //Channel event functions
+  std::uint8_t* ChannelEvent::encodeInto(std::uint8_t* out) const
+  {
     //Delta Time
-    for (std::size_t i = 0; i < deltaTime_.size(); i++)
-      {
-        out.push_back(deltaTime_[i]);
-      }
+    out = deltaTime_.encodeInto(out);
     //Type and MIDI channel
-    out.push_back((type_ << 4) | (channel_ & 0x0F));
+    *out++ = (type_ << 4) | (channel_ & 0x0F);
     //Parameter 1
-    out.push_back(param1_);
-    //Parameter 2
-    if (param2_ != 0) out.push_back(param2_);
+    *out++ = param1_;
+    //Parameter 2, if this type has one
+    if (type_ != 0x0C && type_ != 0x0D) *out++ = param2_;
 
-    //Return the completed data
     return out;
   }
 
   std::size_t ChannelEvent::size() const
   {
-    if (param2_ != 0) return deltaTime_.size() + 3;
+    //Program Change and Channel Aftertouch only have one parameter
+    if (type_ != 0x0C && type_ != 0x0D) return deltaTime_.size() + 3;
     return deltaTime_.size() + 2;
   }
 
+  //Note Off is written as Note On so that both can share a status byte
+  std::uint8_t ChannelEvent::runningStatusByte() const
+  {
+    if (type_ == 0x08) return 0x90 | (channel_ & 0x0F);
+    return (type_ << 4) | (channel_ & 0x0F);
+  }
+
+  std::size_t ChannelEvent::runningSize(std::uint8_t & status) const
+  {
+    std::uint8_t current = runningStatusByte();
+    std::size_t ret = size();
+    if (current == status) ret--;
+    status = current;
+    return ret;
+  }
+
+  std::uint8_t* ChannelEvent::runningEncodeInto(std::uint8_t* out, std::uint8_t & status) const
+  {
+    //Delta Time
+    out = deltaTime_.encodeInto(out);
+    //Status, only if it changed
+    std::uint8_t current = runningStatusByte();
+    if (current != status) *out++ = current;
+    status = current;
+    //Parameter 1
+    *out++ = param1_;
+    //Parameter 2, with Note Off velocity becoming a Note On velocity of 0
+    if (type_ == 0x08) *out++ = 0;
+    else if (type_ != 0x0C && type_ != 0x0D) *out++ = param2_;
+
+    return out;
+  }
+
   std::uint16_t ChannelEvent::getNote() const
   {
     if (usesNote_ == 1)
@@ -146,26 +212,14 @@ namespace midi
   }
 
   //MetaEvent functions
-  std::vector<std::uint8_t> MetaEvent::data() const
+  std::uint8_t* MetaEvent::encodeInto(std::uint8_t* out) const
   {
-    //Create the output vector
-    std::vector<std::uint8_t> out;
-
-    //Fill it up
-    for (std::size_t i = 0; i < deltaTime_.size(); i++)
-      {
-        out.push_back(deltaTime_[i]);
-      }
-    out.push_back(0xFF);
-    out.push_back(type_);
-    for (std::size_t i = 0; i < length_.size(); i++)
-      {
-        out.push_back(length_[i]);
-      }
-    out.insert(out.end(), data_.begin(), data_.end());
-
-    //Return
-    return out;
+    out = deltaTime_.encodeInto(out);
+    *out++ = 0xFF;
+    *out++ = type_;
+    out = length_.encodeInto(out);
+    if (!data_.empty()) std::memcpy(out, data_.begin(), data_.size());
+    return out + data_.size();
   }
 
   std::size_t MetaEvent::size() const
@@ -178,6 +232,20 @@ namespace midi
     return 256;
   }
 
+  //Copies the payload into the arena unless it's already a view
+  void MetaEvent::payloadToArena(EventArena & arena)
+  {
+    if (data_.isView()) return;
+    std::size_t size = data_.size();
+    data_ = Payload::view(arena.copy(data_.begin(), size), size);
+  }
+
+  //Copies an event and its payload into the arena without going through the heap
+  MetaEvent::MetaEvent(const MetaEvent & other, EventArena & arena) :
+    Event(other), length_(other.length_),
+    data_(Payload::view(arena.copy(other.data_.begin(), other.data_.size()),
+                        other.data_.size())) {}
+
   //Sequence Number event
   SequenceNumberEvent::SequenceNumberEvent(std::uint16_t number)
   {
@@ -356,30 +424,28 @@ namespace midi
     deltaTime_ = deltaTime;
     type_ = 0x7F;
     length_ = input.size();
-    data_.insert(data_.end(), input.begin(), input.end());
+    data_.append(input.begin(), input.end());
     usesNote_ = 0;
   }
 
-  //SysExEvent functions
-  std::vector<std::uint8_t> SysExEvent::data() const
+  //Raw Meta Event
+  RawMetaEvent::RawMetaEvent(std::uint32_t deltaTime, std::uint8_t type, Payload data)
   {
-    //Create the output vector
-    std::vector<std::uint8_t> out;
-
-    //Fill it up
-    for (std::size_t i = 0; i < deltaTime_.size(); i++)
-      {
-        out.push_back(deltaTime_[i]);
-      }
-    out.push_back(type_);
-    for (std::size_t i = 0; i < length_.size(); i++)
-      {
-        out.push_back(length_[i]);
-      }
-    out.insert(out.end(), data_.begin(), data_.end());
+    deltaTime_ = deltaTime;
+    type_ = type;
+    length_ = data.size();
+    data_ = std::move(data);
+    usesNote_ = 0;
+  }
 
-    //Return
-    return out;
+  //SysExEvent functions
+  std::uint8_t* SysExEvent::encodeInto(std::uint8_t* out) const
+  {
+    out = deltaTime_.encodeInto(out);
+    *out++ = type_;
+    out = length_.encodeInto(out);
+    if (!data_.empty()) std::memcpy(out, data_.begin(), data_.size());
+    return out + data_.size();
   }
 
   std::size_t SysExEvent::size() const
@@ -392,13 +458,27 @@ namespace midi
     return 256;
   }
 
+  //Copies the payload into the arena unless it's already a view
+  void SysExEvent::payloadToArena(EventArena & arena)
+  {
+    if (data_.isView()) return;
+    std::size_t size = data_.size();
+    data_ = Payload::view(arena.copy(data_.begin(), size), size);
+  }
+
+  //Copies an event and its payload into the arena without going through the heap
+  SysExEvent::SysExEvent(const SysExEvent & other, EventArena & arena) :
+    Event(other), length_(other.length_),
+    data_(Payload::view(arena.copy(other.data_.begin(), other.data_.size()),
+                        other.data_.size())) {}
+
   //Normal SysEx event
   NormalSysExEvent::NormalSysExEvent(std::uint32_t deltaTime, std::vector<std::uint8_t> data, bool startDivide)
   {
     deltaTime_ = deltaTime;
     type_ = 0xF0;
     length_ = data.size() + (startDivide?0:1);
-    data_.insert(data_.end(), data.begin(), data.end());
+    data_.append(data.begin(), data.end());
     if (!startDivide) data_.push_back(0xF7);
     usesNote_ = 0;
   }
@@ -409,7 +489,7 @@ namespace midi
     deltaTime_ = deltaTime;
     type_ = 0xF7;
     length_ = data.size() + (endDivide?1:0);
-    data_.insert(data_.end(), data.begin(), data.end());
+    data_.append(data.begin(), data.end());
     if (endDivide) data_.push_back(0xF7);
     usesNote_ = 0;
   }
@@ -420,8 +500,99 @@ namespace midi
     deltaTime_ = deltaTime;
     type_ = 0xF7;
     length_ = data.size();
-    data_.insert(data_.end(), data.begin(), data.end());
+    data_.append(data.begin(), data.end());
+    usesNote_ = 0;
+  }
+
+  //Raw SysEx event
+  RawSysExEvent::RawSysExEvent(std::uint32_t deltaTime, std::uint8_t type, Payload data)
+  {
+    deltaTime_ = deltaTime;
+    type_ = type;
+    length_ = data.size();
+    data_ = std::move(data);
     usesNote_ = 0;
   }
 
+  //Decodes a single event from the raw bytes of a track
+  Event* readEvent(const std::uint8_t* & pos, const std::uint8_t* end,
+                   std::uint8_t & runningStatus)
+  {
+    const std::uint8_t* p = pos;
+
+    //Delta time
+    std::uint32_t deltaTime;
+    if (!readVarLength(p, end, deltaTime)) return NULL;
+    if (p == end) return NULL;
+
+    //Meta events
+    if (*p == 0xFF)
+      {
+        p++;
+        if (p == end) return NULL;
+        std::uint8_t type = *p++;
+        std::uint32_t length;
+        if (!readVarLength(p, end, length)) return NULL;
+        if (std::size_t(end - p) < length) return NULL;
+        Event* ev = new RawMetaEvent(deltaTime, type, Payload::view(p, length));
+        pos = p + length;
+        return ev;
+      }
+
+    //SysEx events
+    if (*p == 0xF0 || *p == 0xF7)
+      {
+        std::uint8_t type = *p++;
+        std::uint32_t length;
+        if (!readVarLength(p, end, length)) return NULL;
+        if (std::size_t(end - p) < length) return NULL;
+        Event* ev = new RawSysExEvent(deltaTime, type, Payload::view(p, length));
+        pos = p + length;
+        return ev;
+      }
+
+    //Channel events, possibly using running status
+    std::uint8_t status;
+    if (*p & 0x80)
+      {
+        status = *p++;
+        if (status >= 0xF0) return NULL;
+        runningStatus = status;
+      }
+    else
+      {
+        if (runningStatus == 0) return NULL;
+        status = runningStatus;
+      }
+
+    std::uint8_t type = status >> 4;
+    std::size_t params = (type == 0x0C || type == 0x0D) ? 1 : 2;
+    if (std::size_t(end - p) < params) return NULL;
+    std::uint8_t param1 = p[0];
+    std::uint8_t param2 = (params == 2) ? p[1] : 0;
+    if ((param1 | param2) & 0x80) return NULL;
+    pos = p + params;
+
+    return makeChannelEvent(deltaTime, status, param1, param2);
+  }
+
+  //Creates the channel event described by a status byte and its parameters
+  Event* makeChannelEvent(std::uint32_t deltaTime, std::uint8_t status,
+                          std::uint8_t param1, std::uint8_t param2)
+  {
+    std::uint8_t channel = status & 0x0F;
+    switch (status >> 4)
+      {
+      case 0x08: return new NoteOffEvent(deltaTime, channel, param1, param2);
+      case 0x09: return new NoteOnEvent(deltaTime, channel, param1, param2);
+      case 0x0A: return new NoteAftertouchEvent(deltaTime, channel, param1, param2);
+      case 0x0B: return new ControllerEvent(deltaTime, channel, param1, param2);
+      case 0x0C: return new ProgramChangeEvent(deltaTime, channel,
+                                               static_cast<Instrument>(param1));
+      case 0x0D: return new ChannelAftertouchEvent(deltaTime, channel, param1);
+      case 0x0E: return new PitchBendEvent(deltaTime, channel, (param1 << 8) | param2);
+      default: return NULL;
+      }
+  }
+
 } //Namespace
@@ -13,6 +13,8 @@
 #define _event_hpp_
 
 #include "varlength.hpp"
+#include "payload.hpp"
+#include "arena.hpp"
 #include "instruments.hpp"
 
 #include <vector>
@@ -26,11 +28,26 @@ namespace midi
   public:
     virtual ~Event() {};
     virtual Event* clone() const = 0;
-    virtual std::vector<std::uint8_t> data() const = 0;
+    virtual Event* clone(EventArena & arena) const = 0;
+    std::vector<std::uint8_t> data() const;
     virtual std::size_t size() const = 0;
     std::uint32_t dt() const;
     void setdt(std::uint32_t indt);
     virtual std::uint16_t getNote() const = 0;
+
+    //Writes exactly size() bytes starting at out, returning the end
+    virtual std::uint8_t* encodeInto(std::uint8_t* out) const = 0;
+    void encodeInto(std::vector<std::uint8_t> & out) const;
+
+    //Size and data when the status byte may be shared with the previous event.
+    //status is the last status byte written, and is updated.
+    virtual std::size_t runningSize(std::uint8_t & status) const;
+    virtual std::uint8_t* runningEncodeInto(std::uint8_t* out, std::uint8_t & status) const;
+    std::vector<std::uint8_t> runningData(std::uint8_t & status) const;
+
+    //Objects in an arena are never destroyed, so an event placed there must
+    //not own any other memory. This moves whatever it owns into the arena.
+    virtual void payloadToArena(EventArena &) {}
   
   protected:
     //Common structure
@@ -48,11 +65,25 @@ namespace midi
     virtual ~ChannelEvent() {};
     
     //All channel events write themselves the same way
-    std::vector<std::uint8_t> data() const;
+    using Event::encodeInto;
+    std::uint8_t* encodeInto(std::uint8_t* out) const;
     std::size_t size() const;
     std::uint16_t getNote() const;
+
+    //Accessors for the status byte, channel and parameters
+    std::uint8_t status() const {return (type_ << 4) | (channel_ & 0x0F);}
+    std::uint8_t channel() const {return channel_;}
+    std::uint8_t param1() const {return param1_;}
+    std::uint8_t param2() const {return param2_;}
+
+    //Running status encoding, which writes Note Off as Note On with velocity 0
+    std::size_t runningSize(std::uint8_t & status) const;
+    std::uint8_t* runningEncodeInto(std::uint8_t* out, std::uint8_t & status) const;
   
   protected:
+    //Status byte as written with running status
+    std::uint8_t runningStatusByte() const;
+
     //MIDI Channel Event format
     std::uint8_t channel_;
     std::uint8_t param1_;
@@ -65,6 +96,7 @@ namespace midi
   public:
     NoteOffEvent(std::uint32_t deltaTime, std::uint8_t channel, std::uint8_t note, std::uint8_t velocity);
     Event* clone() const {return new NoteOffEvent(deltaTime_, channel_, param1_, param2_);}
+    Event* clone(EventArena & arena) const {return new (arena) NoteOffEvent(*this);}
   };
 
   //Note On event
@@ -73,6 +105,7 @@ namespace midi
   public:
     NoteOnEvent(std::uint32_t deltaTime, std::uint8_t channel, std::uint8_t note, std::uint8_t velocity);
     Event* clone() const {return new NoteOnEvent(deltaTime_, channel_, param1_, param2_);}
+    Event* clone(EventArena & arena) const {return new (arena) NoteOnEvent(*this);}
   };
 
   //Note Aftertouch event
@@ -81,6 +114,7 @@ namespace midi
   public:
     NoteAftertouchEvent(std::uint32_t deltaTime, std::uint8_t channel, std::uint8_t note, std::uint8_t amount);
     Event* clone() const {return new NoteAftertouchEvent(deltaTime_, channel_, param1_, param2_);}
+    Event* clone(EventArena & arena) const {return new (arena) NoteAftertouchEvent(*this);}
   };
 
   //Controller event
@@ -89,6 +123,7 @@ namespace midi
   public:
     ControllerEvent(std::uint32_t deltaTime, std::uint8_t channel, std::uint8_t type, std::uint8_t value);
     Event* clone() const {return new ControllerEvent(deltaTime_, channel_, param1_, param2_);}
+    Event* clone(EventArena & arena) const {return new (arena) ControllerEvent(*this);}
   };
 
   //Program Change event
@@ -97,6 +132,7 @@ namespace midi
   public:
     ProgramChangeEvent(std::uint32_t deltaTime, std::uint8_t channel, Instrument number);
     Event* clone() const {return new ProgramChangeEvent(deltaTime_, channel_, static_cast<Instrument>(param1_));}
+    Event* clone(EventArena & arena) const {return new (arena) ProgramChangeEvent(*this);}
   };
 
   //Channel Aftertouch event
@@ -105,6 +141,7 @@ namespace midi
   public:
     ChannelAftertouchEvent(std::uint32_t deltaTime, std::uint8_t channel, std::uint8_t amount);
     Event* clone() const {return new ChannelAftertouchEvent(deltaTime_, channel_, param1_);}
+    Event* clone(EventArena & arena) const {return new (arena) ChannelAftertouchEvent(*this);}
   };
 
   //Pitch Bend event
@@ -112,7 +149,8 @@ namespace midi
   {
   public:
     PitchBendEvent(std::uint32_t deltaTime, std::uint8_t channel, std::uint16_t value);
-    Event* clone() const {return new PitchBendEvent(deltaTime_, channel_, (param2_<<7)|param1_);}
+    Event* clone() const {return new PitchBendEvent(*this);}
+    Event* clone(EventArena & arena) const {return new (arena) PitchBendEvent(*this);}
   };
 
   //*****META EVENTS*****
@@ -124,133 +162,187 @@ namespace midi
   
     //Size is not the same for all meta events, but required for proper writing
     std::size_t size() const;
-    virtual std::vector<std::uint8_t> data() const;
+    using Event::encodeInto;
+    std::uint8_t* encodeInto(std::uint8_t* out) const;
     std::uint16_t getNote() const;
+
+    //Accessors for the raw contents
+    std::uint8_t metaType() const {return type_;}
+    const Payload & payload() const {return data_;}
   
+    //Implementation of Event::payloadToArena
+    void payloadToArena(EventArena & arena);
+
   protected:
+    MetaEvent() {}
+
+    //Copy constructed in an arena, with the payload copied there directly
+    MetaEvent(const MetaEvent & other, EventArena & arena);
+
     //MIDI Meta Event format
     VarLength length_;
-    std::vector<std::uint8_t> data_;
+    Payload data_;
   };
 
   //Sequence Number event
   class SequenceNumberEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     SequenceNumberEvent(std::uint16_t number);
     Event* clone() const {return new SequenceNumberEvent((data_[0]<<8)|data_[1]);}
+    Event* clone(EventArena & arena) const {return new (arena) SequenceNumberEvent(*this, arena);}
   };
 
   //Text event
   class TextEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     TextEvent(std::string text);
     Event* clone() const {return new TextEvent(std::string(data_.begin(), data_.end()));}
+    Event* clone(EventArena & arena) const {return new (arena) TextEvent(*this, arena);}
   };
 
   //Copyright Notice event
   class CopyrightNoticeEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     CopyrightNoticeEvent(std::string text);
     Event* clone() const {return new CopyrightNoticeEvent(std::string(data_.begin(), data_.end()));}
+    Event* clone(EventArena & arena) const {return new (arena) CopyrightNoticeEvent(*this, arena);}
   };
 
   //Sequence/Track Name event
   class SequenceTrackNameEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     SequenceTrackNameEvent(std::string text);
     Event* clone() const {return new SequenceTrackNameEvent(std::string(data_.begin(), data_.end()));}
+    Event* clone(EventArena & arena) const {return new (arena) SequenceTrackNameEvent(*this, arena);}
   };
 
   //Instrument Name event
   class InstrumentNameEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     InstrumentNameEvent(std::string text);
     Event* clone() const {return new InstrumentNameEvent(std::string(data_.begin(), data_.end()));}
+    Event* clone(EventArena & arena) const {return new (arena) InstrumentNameEvent(*this, arena);}
   };
 
   //Lyrics event
   class LyricsEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     LyricsEvent(std::uint32_t deltaTime, std::string text);
     Event* clone() const {return new LyricsEvent(deltaTime_, std::string(data_.begin(), data_.end()));}
+    Event* clone(EventArena & arena) const {return new (arena) LyricsEvent(*this, arena);}
   };
 
   //Marker event
   class MarkerEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     MarkerEvent(std::uint32_t deltaTime, std::string text);
     Event* clone() const {return new MarkerEvent(deltaTime_, std::string(data_.begin(), data_.end()));}
+    Event* clone(EventArena & arena) const {return new (arena) MarkerEvent(*this, arena);}
   };
 
   //Cue Point event
   class CuePointEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     CuePointEvent(std::uint32_t deltaTime, std::string text);
     Event* clone() const {return new CuePointEvent(deltaTime_, std::string(data_.begin(), data_.end()));}
+    Event* clone(EventArena & arena) const {return new (arena) CuePointEvent(*this, arena);}
   };
 
   //MIDI Channel Prefix event
   class MIDIChannelPrefixEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     MIDIChannelPrefixEvent(std::uint32_t deltaTime, std::uint8_t channel);
     Event* clone() const {return new MIDIChannelPrefixEvent(deltaTime_, data_[0]);}
+    Event* clone(EventArena & arena) const {return new (arena) MIDIChannelPrefixEvent(*this, arena);}
   };
 
   //End Of Track event
   class EndOfTrackEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     EndOfTrackEvent(std::uint32_t deltaTime);
     Event* clone() const {return new EndOfTrackEvent(deltaTime_);}
+    Event* clone(EventArena & arena) const {return new (arena) EndOfTrackEvent(*this, arena);}
   };
 
   //Set Tempo event
   class SetTempoEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     SetTempoEvent(std::uint32_t deltaTime, std::uint32_t mspq);
     Event* clone() const {return new SetTempoEvent(deltaTime_, (data_[0]<<16)|(data_[1]<<8)|data_[2]);}
+    Event* clone(EventArena & arena) const {return new (arena) SetTempoEvent(*this, arena);}
   };
 
   //SMPTE Offset event
   class SMPTEOffsetEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     SMPTEOffsetEvent(std::uint32_t deltaTime, std::uint8_t hour, std::uint8_t minute, std::uint8_t second, std::uint8_t frame, std::uint8_t sub_frame);
     Event* clone() const {return new SMPTEOffsetEvent(deltaTime_, data_[0], data_[1], data_[2], data_[3], data_[4]);}
+    Event* clone(EventArena & arena) const {return new (arena) SMPTEOffsetEvent(*this, arena);}
   };
 
   //Time Signature Event
   class TimeSignatureEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     TimeSignatureEvent(std::uint32_t deltaTime, std::uint8_t numerator, std::uint8_t denominator, std::uint8_t metronome, std::uint8_t num32s);
     Event* clone() const {return new TimeSignatureEvent(deltaTime_, data_[0], data_[1], data_[2], data_[3]);}
+    Event* clone(EventArena & arena) const {return new (arena) TimeSignatureEvent(*this, arena);}
   };
 
   //Key Signature Event
   class KeySignatureEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     KeySignatureEvent(std::uint32_t deltaTime, char key, bool scale);
     Event* clone() const {return new KeySignatureEvent(deltaTime_, data_[0], data_[1]);}
+    Event* clone(EventArena & arena) const {return new (arena) KeySignatureEvent(*this, arena);}
   };
 
   //Sequencer Specific Event
   class SequencerSpecificEvent : public MetaEvent
   {
   public:
+    using MetaEvent::MetaEvent;
     SequencerSpecificEvent(std::uint32_t deltaTime, std::vector<std::uint8_t> input);
     Event* clone() const {return new SequencerSpecificEvent(deltaTime_, data_);}
+    Event* clone(EventArena & arena) const {return new (arena) SequencerSpecificEvent(*this, arena);}
+  };
+
+  //Meta event of any type, as read from a file
+  //The payload may be a view into the file's memory
+  class RawMetaEvent : public MetaEvent
+  {
+  public:
+    using MetaEvent::MetaEvent;
+    RawMetaEvent(std::uint32_t deltaTime, std::uint8_t type, Payload data);
+    Event* clone() const {return new RawMetaEvent(deltaTime_, type_, data_);}
+    Event* clone(EventArena & arena) const {return new (arena) RawMetaEvent(*this, arena);}
   };
 
   //*****SysEx Events*****
@@ -261,38 +353,81 @@ namespace midi
   
     //We don't know the length of these normally
     std::size_t size() const;
-    std::vector<std::uint8_t> data() const;
+    using Event::encodeInto;
+    std::uint8_t* encodeInto(std::uint8_t* out) const;
     std::uint16_t getNote() const;
 
+    //Accessors for the raw contents
+    std::uint8_t sysExType() const {return type_;}
+    const Payload & payload() const {return data_;}
+
+    //Implementation of Event::payloadToArena
+    void payloadToArena(EventArena & arena);
+
   protected:
+    SysExEvent() {}
+
+    //Copy constructed in an arena, with the payload copied there directly
+    SysExEvent(const SysExEvent & other, EventArena & arena);
+
     VarLength length_;
-    std::vector<std::uint8_t> data_;
+    Payload data_;
   };
 
   //Normal SysEx Event
   class NormalSysExEvent : public SysExEvent
   {
   public:
+    using SysExEvent::SysExEvent;
     NormalSysExEvent(std::uint32_t deltaTime, std::vector<std::uint8_t> data, bool startDivide = false);
     Event* clone() const {return new NormalSysExEvent(deltaTime_, data_, true);}
+    Event* clone(EventArena & arena) const {return new (arena) NormalSysExEvent(*this, arena);}
   };
 
   //Divided SysEx Event
   class DividedSysExEvent : public SysExEvent
   {
   public:
+    using SysExEvent::SysExEvent;
     DividedSysExEvent(std::uint32_t deltaTime, std::vector<std::uint8_t> data, bool endDivide = false);
     Event* clone() const {return new DividedSysExEvent(deltaTime_, data_, false);}
+    Event* clone(EventArena & arena) const {return new (arena) DividedSysExEvent(*this, arena);}
   };
 
   //Authorization SysEx Event
   class AuthorizationSysExEvent : public SysExEvent
   {
   public:
+    using SysExEvent::SysExEvent;
     AuthorizationSysExEvent(std::uint32_t deltaTime, std::vector<std::uint8_t> data);
     Event* clone() const {return new AuthorizationSysExEvent(deltaTime_, data_);}
+    Event* clone(EventArena & arena) const {return new (arena) AuthorizationSysExEvent(*this, arena);}
   };
 
+  //SysEx event of either type, as read from a file
+  //The payload may be a view into the file's memory
+  class RawSysExEvent : public SysExEvent
+  {
+  public:
+    using SysExEvent::SysExEvent;
+    RawSysExEvent(std::uint32_t deltaTime, std::uint8_t type, Payload data);
+    Event* clone() const {return new RawSysExEvent(deltaTime_, type_, data_);}
+    Event* clone(EventArena & arena) const {return new (arena) RawSysExEvent(*this, arena);}
+  };
+
+  //*****Reading Events*****
+
+  //Creates the channel event described by a status byte and its parameters
+  Event* makeChannelEvent(std::uint32_t deltaTime, std::uint8_t status,
+                          std::uint8_t param1, std::uint8_t param2);
+
+  //Decodes a single event from the raw bytes of a track, advancing pos past it.
+  //runningStatus carries the last channel status byte between calls.
+  //Meta and SysEx payloads are views into the input, which must outlive the event.
+  //Returns NULL if the bytes do not form a valid event.
+  Event* readEvent(const std::uint8_t* & pos, const std::uint8_t* end,
+                   std::uint8_t & runningStatus);
+
 } //Namespace
 
 #endif
@@ -0,0 +1,222 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----LiveParser Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the LiveParser class, which decodes the MIDI
+  wire protocol one byte at a time.
+*/
+
+#include "liveparser.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace midi
+{
+
+  //Number of data bytes following a status byte
+  static std::size_t dataBytes(std::uint8_t status)
+  {
+    switch (status)
+      {
+      case 0xF1: case 0xF3: return 1;
+      case 0xF2: return 2;
+      case 0xF6: return 0;
+      }
+    return (status >> 4 == 0x0C || status >> 4 == 0x0D) ? 1 : 2;
+  }
+
+  //Constructor
+  LiveParser::LiveParser(EventCallback callback, std::size_t sysexCapacity) :
+    callback_(callback), sysex_(sysexCapacity + 1)
+  {
+    reset();
+  }
+
+  //Forget all state
+  void LiveParser::reset()
+  {
+    status_ = 0;
+    runningStatus_ = 0;
+    have_ = 0;
+    need_ = 0;
+    inSysEx_ = false;
+    overflow_ = false;
+    sysexSize_ = 0;
+    messages_ = 0;
+    dropped_ = 0;
+  }
+
+  //Parses a run of bytes
+  void LiveParser::feed(const std::uint8_t* data, std::size_t size,
+                        Clock::time_point time)
+  {
+    for (std::size_t i = 0; i < size; i++)
+      {
+        feed(data[i], time);
+      }
+  }
+
+  //Parses one byte
+  void LiveParser::feed(std::uint8_t byte, Clock::time_point time)
+  {
+    //Realtime messages can appear anywhere, even inside other messages,
+    //and interrupt nothing
+    if (byte >= 0xF8)
+      {
+        messages_++;
+        if (system_) system_(&byte, 1, time);
+        return;
+      }
+
+    //Data bytes
+    if (byte < 0x80)
+      {
+        if (inSysEx_)
+          {
+            if (sysexSize_ + 1 < sysex_.size()) sysex_[sysexSize_++] = byte;
+            else overflow_ = true;
+            return;
+          }
+
+        //Without a status byte, a data byte starts another message of the
+        //running status
+        if (status_ == 0)
+          {
+            if (runningStatus_ == 0)
+              {
+                dropped_++;
+                return;
+              }
+            status_ = runningStatus_;
+            need_ = dataBytes(status_);
+          }
+        if (have_ == 0) start_ = time;
+        data_[have_++] = byte;
+        if (have_ == need_) complete();
+        return;
+      }
+
+    //Any other status byte ends a SysEx message
+    if (byte == 0xF7)
+      {
+        if (!inSysEx_)
+          {
+            dropped_++;
+            return;
+          }
+        inSysEx_ = false;
+        if (overflow_)
+          {
+            dropped_++;
+            return;
+          }
+
+        //The payload is everything after 0xF0, as it would be in a file
+        sysex_[sysexSize_++] = 0xF7;
+        messages_++;
+        RawSysExEvent ev(0, 0xF0, Payload::view(&sysex_[0], sysexSize_));
+        callback_(ev, start_);
+        return;
+      }
+    endSysEx();
+
+    //A message cut off by a status byte is lost
+    if (status_ != 0 && have_ > 0) dropped_++;
+    have_ = 0;
+    start_ = time;
+
+    if (byte == 0xF0)
+      {
+        status_ = 0;
+        runningStatus_ = 0;
+        inSysEx_ = true;
+        overflow_ = false;
+        sysexSize_ = 0;
+        return;
+      }
+
+    //System common messages cancel running status
+    if (byte == 0xF4 || byte == 0xF5)
+      {
+        //Undefined
+        status_ = 0;
+        runningStatus_ = 0;
+        dropped_++;
+        return;
+      }
+    status_ = byte;
+    need_ = dataBytes(byte);
+    if (byte >= 0xF0) runningStatus_ = 0;
+    else runningStatus_ = byte;
+    if (need_ == 0) complete();
+  }
+
+  //Delivers the current message
+  void LiveParser::complete()
+  {
+    std::uint8_t status = status_;
+    std::uint8_t channel = status & 0x0F;
+    std::uint8_t param1 = data_[0];
+    std::uint8_t param2 = data_[1];
+    messages_++;
+
+    //Channel messages leave the running status for the next one
+    status_ = 0;
+    have_ = 0;
+
+    switch (status >> 4)
+      {
+      case 0x08: callback_(NoteOffEvent(0, channel, param1, param2), start_); break;
+      case 0x09: callback_(NoteOnEvent(0, channel, param1, param2), start_); break;
+      case 0x0A: callback_(NoteAftertouchEvent(0, channel, param1, param2), start_); break;
+      case 0x0B: callback_(ControllerEvent(0, channel, param1, param2), start_); break;
+      case 0x0C:
+        callback_(ProgramChangeEvent(0, channel, static_cast<Instrument>(param1)), start_);
+        break;
+      case 0x0D: callback_(ChannelAftertouchEvent(0, channel, param1), start_); break;
+      case 0x0E: callback_(PitchBendEvent(0, channel, (param1 << 8) | param2), start_); break;
+      default:
+        {
+          //System common, with the status byte first
+          std::uint8_t message[3] = {status, param1, param2};
+          if (system_) system_(message, 1 + dataBytes(status), start_);
+        }
+      }
+  }
+
+  //Abandons a SysEx message cut off by a status byte
+  void LiveParser::endSysEx()
+  {
+    if (!inSysEx_) return;
+    inSysEx_ = false;
+    dropped_++;
+  }
+
+  //Reads once from a file descriptor
+  long LiveParser::readFrom(int fd)
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    for (;;)
+      {
+        ssize_t got = ::read(fd, readBuffer_, sizeof(readBuffer_));
+        if (got < 0)
+          {
+            if (errno == EINTR) continue;
+            return -1;
+          }
+        feed(readBuffer_, got, Clock::now());
+        return got;
+      }
+#else
+    return -1;
+#endif
+  }
+
+} //Namespace
@@ -0,0 +1,99 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----LiveParser Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the LiveParser class, which decodes the MIDI wire
+  protocol one byte at a time, as sent between live devices.
+*/
+
+#ifndef _liveparser_hpp_
+#define _liveparser_hpp_
+
+#include "event.hpp"
+
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+namespace midi
+{
+
+  //Unlike a file, a live stream has no delta times or meta events. Messages
+  //are decoded into events on the stack, and SysEx is collected in a buffer
+  //allocated once, so nothing is allocated per message.
+  class LiveParser
+  {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    //Called for every channel message and complete SysEx message, with the
+    //time its first byte arrived. Delta times are 0. SysEx events are
+    //RawSysExEvents of type 0xF0. The event is only valid during the call.
+    typedef std::function<void(const Event &, Clock::time_point)> EventCallback;
+
+    //Called for system realtime and system common messages, which have no
+    //event classes, with their status byte and any data bytes
+    typedef std::function<void(const std::uint8_t*, std::size_t, Clock::time_point)> SystemCallback;
+
+    //SysEx messages longer than sysexCapacity bytes are dropped
+    LiveParser(EventCallback callback, std::size_t sysexCapacity = 4096);
+    void setSystemCallback(SystemCallback callback) {system_ = callback;}
+
+    //Parses bytes which all arrived at time
+    void feed(std::uint8_t byte, Clock::time_point time);
+    void feed(const std::uint8_t* data, std::size_t size, Clock::time_point time);
+    void feed(const std::uint8_t* data, std::size_t size) {feed(data, size, Clock::now());}
+
+    //Reads whatever is available from a file descriptor, blocking if nothing
+    //is, and parses it. Returns the number of bytes read, 0 at the end of
+    //the input or -1 on error.
+    long readFrom(int fd);
+
+    //Forget all state, such as after a device is reconnected
+    void reset();
+
+    //Statistics
+    std::size_t messages() const {return messages_;}
+    std::size_t dropped() const {return dropped_;}
+
+  private:
+    //Delivers a message once its last data byte arrives
+    void complete();
+
+    //Abandons a SysEx message cut off by a status byte
+    void endSysEx();
+
+    EventCallback callback_;
+    SystemCallback system_;
+
+    //Status of the message being collected, and the one data bytes
+    //without a status byte belong to
+    std::uint8_t status_;
+    std::uint8_t runningStatus_;
+
+    //Data bytes of the current message
+    std::uint8_t data_[2];
+    std::size_t have_;
+    std::size_t need_;
+    Clock::time_point start_;
+
+    //SysEx collection, kept across reads
+    bool inSysEx_;
+    bool overflow_;
+    std::vector<std::uint8_t> sysex_;
+    std::size_t sysexSize_;
+
+    std::size_t messages_;
+    std::size_t dropped_;
+
+    std::uint8_t readBuffer_[1024];
+  };
+
+} //Namespace
+
+#endif
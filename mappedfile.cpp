@@ -0,0 +1,89 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----MappedFile Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the MappedFile class, a read-only file mapped
+  into memory so that its contents can be parsed in place.
+*/
+
+#include "mappedfile.hpp"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MIDI_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace midi
+{
+
+  //Maps the file, falling back to reading it if mapping isn't possible
+  MappedFile::MappedFile(const std::string & filename) :
+    data_(NULL), size_(0), valid_(false), mapped_(false)
+  {
+#ifdef MIDI_USE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+      {
+        close(fd);
+        return;
+      }
+    size_ = st.st_size;
+
+    //Zero-length files can't be mapped, but are still valid files
+    if (size_ == 0)
+      {
+        close(fd);
+        valid_ = true;
+        return;
+      }
+
+    void* addr = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr != MAP_FAILED)
+      {
+        //We read front to back exactly once
+        madvise(addr, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const std::uint8_t*>(addr);
+        mapped_ = true;
+        valid_ = true;
+        return;
+      }
+    size_ = 0;
+#endif
+
+    //Read the whole file instead
+    std::ifstream fin(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!fin) return;
+    fin.seekg(0, std::ios::end);
+    std::streamoff len = fin.tellg();
+    if (len < 0) return;
+    fin.seekg(0, std::ios::beg);
+    buffer_.resize(len);
+    if (len > 0) fin.read((char*)(&buffer_[0]), len);
+    if (!fin) return;
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    valid_ = true;
+  }
+
+  //Destructor, releases the mapping
+  MappedFile::~MappedFile()
+  {
+#ifdef MIDI_USE_MMAP
+    if (mapped_) munmap(const_cast<std::uint8_t*>(data_), size_);
+#endif
+  }
+
+} //Namespace
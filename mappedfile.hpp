@@ -0,0 +1,52 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----MappedFile Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the MappedFile class, a read-only file mapped into
+  memory so that its contents can be parsed in place.
+*/
+
+#ifndef _mappedfile_hpp_
+#define _mappedfile_hpp_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace midi
+{
+
+  class MappedFile
+  {
+  public:
+    //Maps the whole file. Check valid() afterwards.
+    MappedFile(const std::string & filename);
+    ~MappedFile();
+
+    //Access
+    bool valid() const {return valid_;}
+    const std::uint8_t* data() const {return data_;}
+    std::size_t size() const {return size_;}
+
+  private:
+    //Mappings can't be shared
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const std::uint8_t* data_;
+    std::size_t size_;
+    bool valid_;
+    bool mapped_;
+
+    //Used where memory mapping is unavailable
+    std::vector<std::uint8_t> buffer_;
+  };
+
+} //Namespace
+
+#endif
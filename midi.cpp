@@ -11,12 +11,15 @@
 
 #include "midi.hpp"
 
+#include <utility>
+#include <functional>
+
 namespace midi
 {
 
   //MIDI Class Functions
   //Writes the data to a file
-  void MIDI::write(std::string filename) const
+  bool MIDI::write(std::string filename) const
   {
     //Open the file
     std::ofstream fout(filename.c_str(), std::ios_base::out |
@@ -24,13 +27,97 @@ namespace midi
                        std::ios_base::binary);
 
     //Verify that it opened
-    if (!fout) return;
+    if (!fout) return false;
 
     //Write data
-    fout.write((const char*)(&(data()[0])), size());
+    StreamSink sink(fout);
+    if (!write(sink)) return false;
 
     //Close file stream
     fout.close();
+    return !fout.fail();
+  }
+
+  //Writes the 14 byte file header
+  std::uint8_t* MIDI::encodeHeader(std::uint8_t* out) const
+  {
+    std::vector<std::uint8_t> td = td_.data();
+    std::size_t tracks = numTracks();
+    *out++ = 0x4D;
+    *out++ = 0x54;
+    *out++ = 0x68;
+    *out++ = 0x64;
+    *out++ = 0;
+    *out++ = 0;
+    *out++ = 0;
+    *out++ = 6;
+
+    *out++ = 0;
+    *out++ = type();
+
+    *out++ = tracks >> 8;
+    *out++ = tracks & 0xFF;
+
+    *out++ = td[0];
+    *out++ = td[1];
+    return out;
+  }
+
+  //Streams the header and each track to the sink
+  bool MIDI::write(ByteSink & sink) const
+  {
+    std::uint8_t header[14];
+    encodeHeader(header);
+    if (!sink.write(header, 14)) return false;
+
+    for (std::size_t i = 0; i < numTracks(); i++)
+      {
+        if (!track(i).write(sink)) return false;
+      }
+
+    return sink.flush();
+  }
+
+  //Encodes the header and every track into one vector
+  std::vector<std::uint8_t> MIDI::data() const
+  {
+    std::vector<std::uint8_t> out(size());
+    std::uint8_t* pos = encodeHeader(&out[0]);
+    for (std::size_t i = 0; i < numTracks(); i++)
+      {
+        pos = track(i).encodeInto(pos);
+      }
+    return out;
+  }
+
+  //Track offsets are known from their sizes, so each track can be encoded
+  //straight into place without waiting for the ones before it. Sizing can
+  //cost as much as encoding (a NoteTrack builds its encoding to know its
+  //size), so that is spread over the pool too.
+  std::vector<std::uint8_t> MIDI::data(ThreadPool & pool) const
+  {
+    std::size_t tracks = numTracks();
+    std::vector<std::size_t> trackSize(tracks);
+    pool.parallelFor(tracks, [&](std::size_t i)
+                     {
+                       trackSize[i] = track(i).size();
+                     });
+
+    std::size_t total = 14;
+    std::vector<std::size_t> start(tracks);
+    for (std::size_t i = 0; i < tracks; i++)
+      {
+        start[i] = total;
+        total += trackSize[i];
+      }
+
+    std::vector<std::uint8_t> out(total);
+    encodeHeader(&out[0]);
+    pool.parallelFor(tracks, [&](std::size_t i)
+                     {
+                       track(i).encodeInto(&out[start[i]]);
+                     });
+    return out;
   }
 
   //Time division setter
@@ -47,6 +134,52 @@ namespace midi
     td_ = td;
   }
 
+  //Constructors taking the contents of a temporary track
+  MIDI_Type0::MIDI_Type0(Track && tr, const TimeDivision & td)
+  {
+    track_ = tr.moveClone();
+    td_ = td;
+  }
+
+  //Constructors taking ownership of an allocated track
+  MIDI_Type0::MIDI_Type0(std::unique_ptr<Track> tr, const TimeDivision & td)
+  {
+    track_ = tr.release();
+    td_ = td;
+  }
+
+  //Copies are deep
+  MIDI_Type0::MIDI_Type0(const MIDI_Type0 & other) : MIDI(other)
+  {
+    track_ = (other.track_ != NULL) ? other.track_->clone() : NULL;
+  }
+
+  //Moves take the track, leaving the other MIDI empty
+  MIDI_Type0::MIDI_Type0(MIDI_Type0 && other) : MIDI(other)
+  {
+    track_ = other.track_;
+    other.track_ = NULL;
+  }
+
+  MIDI_Type0 & MIDI_Type0::operator=(const MIDI_Type0 & other)
+  {
+    if (this == &other) return *this;
+    clear();
+    MIDI::operator=(other);
+    track_ = (other.track_ != NULL) ? other.track_->clone() : NULL;
+    return *this;
+  }
+
+  MIDI_Type0 & MIDI_Type0::operator=(MIDI_Type0 && other)
+  {
+    if (this == &other) return *this;
+    clear();
+    MIDI::operator=(other);
+    track_ = other.track_;
+    other.track_ = NULL;
+    return *this;
+  }
+
   //Destructor
   MIDI_Type0::~MIDI_Type0()
   {
@@ -56,41 +189,15 @@ namespace midi
   //Size
   std::size_t MIDI_Type0::size() const
   {
-    return 14 + track_->size();
+    return 14 + (track_ != NULL ? track_->size() : 0);
   }
 
-  //Data
-  std::vector<std::uint8_t> MIDI_Type0::data() const
+  //Track accessor
+  const Track & MIDI_Type0::track(std::size_t) const
   {
-    //Create the output vector
-    std::vector<std::uint8_t> out;
-  
-    //MIDI header
-    out.reserve(14);
-    out.push_back(0x4D);
-    out.push_back(0x54);
-    out.push_back(0x68);
-    out.push_back(0x64);
-    out.push_back(0);
-    out.push_back(0);
-    out.push_back(0);
-    out.push_back(6);
-
-    out.push_back(0);
-    out.push_back(0);
-
-    out.push_back(0);
-    out.push_back(1);
-
-    std::vector<std::uint8_t> td = td_.data();
-    out.insert(out.end(), td.begin(), td.end());
-
-    //Track data
-    std::vector<std::uint8_t> tdata = track_->data();
-    out.insert(out.end(), tdata.begin(), tdata.end());
-
-    //Return the output
-    return out;
+    static const EventTrack empty;
+    if (track_ == NULL) return empty;
+    return *track_;
   }
 
   //Track setter
@@ -100,6 +207,18 @@ namespace midi
     track_ = tr.clone();
   }
 
+  void MIDI_Type0::setTrack(Track && tr)
+  {
+    clear();
+    track_ = tr.moveClone();
+  }
+
+  void MIDI_Type0::setTrack(std::unique_ptr<Track> tr)
+  {
+    clear();
+    track_ = tr.release();
+  }
+
   //Clears the track
   void MIDI_Type0::clear()
   {
@@ -109,9 +228,14 @@ namespace midi
 
   //MIDI_Type1 Functions
   //Constructor
-  MIDI_Type1::MIDI_Type1(const std::vector<Track*> & tr, const TimeDivision & td)
+  MIDI_Type1::MIDI_Type1(std::vector<std::unique_ptr<Track> > tr,
+                         const TimeDivision & td)
   {
-    track_ = tr;
+    track_.reserve(tr.size());
+    for (std::size_t i = 0; i < tr.size(); i++)
+      {
+        track_.push_back(tr[i].release());
+      }
     td_ = td;
   }
 
@@ -120,6 +244,50 @@ namespace midi
     td_ = td;
   }
 
+  //Copies are deep
+  MIDI_Type1::MIDI_Type1(const MIDI_Type1 & other) : MIDI(other)
+  {
+    copyTracks(other);
+  }
+
+  //Moves take the tracks, leaving the other MIDI empty
+  MIDI_Type1::MIDI_Type1(MIDI_Type1 && other) :
+    MIDI(other), track_(std::move(other.track_)), arena_(std::move(other.arena_))
+  {
+    other.track_.clear();
+  }
+
+  MIDI_Type1 & MIDI_Type1::operator=(const MIDI_Type1 & other)
+  {
+    if (this == &other) return *this;
+    clear();
+    MIDI::operator=(other);
+    copyTracks(other);
+    return *this;
+  }
+
+  MIDI_Type1 & MIDI_Type1::operator=(MIDI_Type1 && other)
+  {
+    if (this == &other) return *this;
+    clear();
+    MIDI::operator=(other);
+    track_ = std::move(other.track_);
+    arena_ = std::move(other.arena_);
+    other.track_.clear();
+    return *this;
+  }
+
+  //Appends copies of the tracks of another MIDI
+  void MIDI_Type1::copyTracks(const MIDI_Type1 & other)
+  {
+    if (other.arena_) arena_.reset(new EventArena);
+    track_.reserve(track_.size() + other.track_.size());
+    for (std::size_t i = 0; i < other.track_.size(); i++)
+      {
+        track_.push_back(arena_ ? other.track_[i]->cloneInto(arena_) : other.track_[i]->clone());
+      }
+  }
+
   //Destructor
   MIDI_Type1::~MIDI_Type1()
   {
@@ -141,48 +309,26 @@ namespace midi
     return out;
   }
 
-  //Data
-  std::vector<std::uint8_t> MIDI_Type1::data() const
+  //Adds a track to the MIDI
+  void MIDI_Type1::addTrack(const Track & tr)
   {
-    //Create the output vector
-    std::vector<std::uint8_t> out;
-  
-    //MIDI header
-    out.reserve(14);
-    out.push_back(0x4D);
-    out.push_back(0x54);
-    out.push_back(0x68);
-    out.push_back(0x64);
-    out.push_back(0);
-    out.push_back(0);
-    out.push_back(0);
-    out.push_back(6);
-
-    out.push_back(0);
-    out.push_back(1);
-
-    out.push_back(track_.size() >> 8);
-    out.push_back(track_.size() & 0xFF);
-
-    std::vector<std::uint8_t> td = td_.data();
-    out.insert(out.end(), td.begin(), td.end());
-
-    //Track data
-    std::vector<std::uint8_t> tdata;
-    for (std::size_t i = 0; i < track_.size(); i++)
-      {
-        tdata = track_[i]->data();
-        out.insert(out.end(), tdata.begin(), tdata.end());
-      }
+    if (arena_) track_.push_back(tr.cloneInto(arena_));
+    else track_.push_back(tr.clone());
+  }
 
-    //Return the output
-    return out;
+  //Adds a temporary track, taking its contents
+  void MIDI_Type1::addTrack(Track && tr)
+  {
+    //Events are still copied into an arena
+    if (arena_) track_.push_back(tr.cloneInto(arena_));
+    else track_.push_back(tr.moveClone());
   }
 
-  //Adds a track to the MIDI
-  void MIDI_Type1::addTrack(const Track & tr)
+  //Adds an allocated track, taking ownership
+  void MIDI_Type1::addTrack(std::unique_ptr<Track> tr)
   {
-    track_.push_back(tr.clone());
+    if (arena_) track_.push_back(tr->cloneInto(arena_));
+    else track_.push_back(tr.release());
   }
 
   //Clears all tracks from the MIDI
@@ -193,13 +339,27 @@ namespace midi
         delete track_[i];
       }
     track_.resize(0);
+
+    //With the tracks gone the arena's memory can be reused
+    if (arena_ && arena_.use_count() == 1) arena_->release();
+  }
+
+  //Sets up the arena for tracks added later
+  void MIDI_Type1::useArena(std::size_t blockSize)
+  {
+    arena_.reset(new EventArena(blockSize));
   }
 
   //MIDI_Type2 Functions
   //Constructor
-  MIDI_Type2::MIDI_Type2(const std::vector<Track*> & tr, const TimeDivision & td)
+  MIDI_Type2::MIDI_Type2(std::vector<std::unique_ptr<Track> > tr,
+                         const TimeDivision & td)
   {
-    track_ = tr;
+    track_.reserve(tr.size());
+    for (std::size_t i = 0; i < tr.size(); i++)
+      {
+        track_.push_back(tr[i].release());
+      }
     td_ = td;
   }
 
@@ -208,6 +368,48 @@ namespace midi
     td_ = td;
   }
 
+  //Copies are deep
+  MIDI_Type2::MIDI_Type2(const MIDI_Type2 & other) : MIDI(other)
+  {
+    copyTracks(other);
+  }
+
+  //Moves take the tracks, leaving the other MIDI empty
+  MIDI_Type2::MIDI_Type2(MIDI_Type2 && other) :
+    MIDI(other), track_(std::move(other.track_))
+  {
+    other.track_.clear();
+  }
+
+  MIDI_Type2 & MIDI_Type2::operator=(const MIDI_Type2 & other)
+  {
+    if (this == &other) return *this;
+    clear();
+    MIDI::operator=(other);
+    copyTracks(other);
+    return *this;
+  }
+
+  MIDI_Type2 & MIDI_Type2::operator=(MIDI_Type2 && other)
+  {
+    if (this == &other) return *this;
+    clear();
+    MIDI::operator=(other);
+    track_ = std::move(other.track_);
+    other.track_.clear();
+    return *this;
+  }
+
+  //Appends copies of the tracks of another MIDI
+  void MIDI_Type2::copyTracks(const MIDI_Type2 & other)
+  {
+    track_.reserve(track_.size() + other.track_.size());
+    for (std::size_t i = 0; i < other.track_.size(); i++)
+      {
+        track_.push_back(other.track_[i]->clone());
+      }
+  }
+
   //Destructor
   MIDI_Type2::~MIDI_Type2()
   {
@@ -229,48 +431,22 @@ namespace midi
     return out;
   }
 
-  //Data
-  std::vector<std::uint8_t> MIDI_Type2::data() const
+  //Adds a track to the MIDI
+  void MIDI_Type2::addTrack(const Track & tr)
   {
-    //Create the output vector
-    std::vector<std::uint8_t> out;
-  
-    //MIDI header
-    out.reserve(14);
-    out.push_back(0x4D);
-    out.push_back(0x54);
-    out.push_back(0x68);
-    out.push_back(0x64);
-    out.push_back(0);
-    out.push_back(0);
-    out.push_back(0);
-    out.push_back(6);
-
-    out.push_back(0);
-    out.push_back(2);
-
-    out.push_back(track_.size() >> 8);
-    out.push_back(track_.size() & 0xFF);
-
-    std::vector<std::uint8_t> td = td_.data();
-    out.insert(out.end(), td.begin(), td.end());
-
-    //Track data
-    std::vector<std::uint8_t> tdata;
-    for (std::size_t i = 0; i < track_.size(); i++)
-      {
-        tdata = track_[i]->data();
-        out.insert(out.end(), tdata.begin(), tdata.end());
-      }
+    track_.push_back(tr.clone());
+  }
 
-    //Return the output
-    return out;
+  //Adds a temporary track, taking its contents
+  void MIDI_Type2::addTrack(Track && tr)
+  {
+    track_.push_back(tr.moveClone());
   }
 
-  //Adds a track to the MIDI
-  void MIDI_Type2::addTrack(const Track & tr)
+  //Adds an allocated track, taking ownership
+  void MIDI_Type2::addTrack(std::unique_ptr<Track> tr)
   {
-    track_.push_back(tr.clone());
+    track_.push_back(tr.release());
   }
 
   //Clears all tracks from the MIDI
@@ -283,54 +459,115 @@ namespace midi
     track_.resize(0);
   }
 
-  //Loads a midi file into the proper structure, returning a pointer to it.
-  //Returns NULL if the loading failed
-  //THIS MUST BE MANUALLY FREED BY THE USER WITH freeLoadedMIDI
-  /*MIDI* load(std::string filename)
+  //Reads a big-endian 32 bit chunk length
+  static std::uint32_t readChunkSize(const std::uint8_t* p)
+  {
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+      (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+  }
+
+  //Decodes the events of one MTrk chunk in place
+  //Returns NULL if the track is malformed
+  static EventTrack* readTrack(const std::uint8_t* pos, const std::uint8_t* end)
   {
-    //Open the file if possible
-    std::ifstream fin(filename.c_str(), std::ios::in|std::ios::binary);
-    if (!fin) return NULL;
+    EventTrack* track = new EventTrack;
+    std::uint8_t runningStatus = 0;
+    while (pos != end)
+      {
+        Event* ev = readEvent(pos, end, runningStatus);
+        if (ev == NULL)
+          {
+            delete track;
+            return NULL;
+          }
+        track->adopt(ev);
+      }
+    return track;
+  }
+
+  //Decodes a mapped file into the proper structure, except for its source.
+  //Tracks are decoded on the pool if there is one.
+  static MIDI* readMIDI(const MappedFile & file, ThreadPool* pool)
+  {
+    const std::uint8_t* pos = file.data();
+    const std::uint8_t* end = pos + file.size();
 
     //Read the header
-    std::uint8_t header[14];
-    fin.seekg(0, ios::beg);
-    fin.read(header, 14);
+    if (file.size() < 14) return NULL;
+    if (pos[0] != 'M' || pos[1] != 'T' || pos[2] != 'h' || pos[3] != 'd') return NULL;
+    std::uint32_t headerSize = readChunkSize(pos + 4);
+    if (headerSize < 6 || std::size_t(end - pos - 8) < headerSize) return NULL;
 
     //Check the type, time division, and number of tracks
-    std::uint8_t type = header[9];
-    std::uint16_t numTracks = std::uint16_t(header[10])<<8 | header[11];
-    TimeDivision td(std::uint16_t(header[12])<<8 | header[13]);
-
-    //Read in each track;
-    std::vector<Track*> tracks;
-    tracks.resize(numTracks);
-    for (std::uint16_t i = 0; i < numTracks; i++)
+    std::uint16_t type = (std::uint16_t(pos[8]) << 8) | pos[9];
+    std::uint16_t numTracks = (std::uint16_t(pos[10]) << 8) | pos[11];
+    TimeDivision td;
+    td.setRaw(pos[12], pos[13]);
+    if (type > 2 || (type == 0 && numTracks != 1)) return NULL;
+    pos += 8 + headerSize;
+
+    //Find each track, skipping any chunks we don't know
+    std::vector<std::pair<const std::uint8_t*, const std::uint8_t*> > chunks;
+    chunks.reserve(numTracks);
+    while (chunks.size() < numTracks)
       {
-        //Read the track header
-        std::uint8_t t_head[8];
-        file.read(t_head, 8);
-
-        //Find the track size
-        std::uint32_t trackSize = 0;
-        for (int j = 0; j < 4; j++)
-          {
-            trackSize << 8;
-            trackSize |= t_head[4+j];
-          }
+        //Read the chunk header
+        if (end - pos < 8) return NULL;
+        std::uint32_t trackSize = readChunkSize(pos + 4);
+        if (std::size_t(end - pos - 8) < trackSize) return NULL;
+        const std::uint8_t* chunk = pos + 8;
+        bool isTrack = (pos[0] == 'M' && pos[1] == 'T' && pos[2] == 'r' && pos[3] == 'k');
+        pos = chunk + trackSize;
+        if (isTrack) chunks.push_back(std::make_pair(chunk, pos));
+      }
 
-        //Read in the track
-        std::vector<std::uint8_t> tr;
-        tr.resize(trackSize);
-        fin.read(&(tr[0]), trackSize);
+    //Tracks don't depend on each other, so they can be decoded in any order
+    std::vector<std::unique_ptr<Track> > tracks(chunks.size());
+    std::function<void(std::size_t)> decode = [&](std::size_t i)
+      {
+        tracks[i].reset(readTrack(chunks[i].first, chunks[i].second));
+      };
+    if (pool != NULL) pool->parallelFor(chunks.size(), decode);
+    else for (std::size_t i = 0; i < chunks.size(); i++) decode(i);
 
-        //Put together the delta time
+    //Anything read is freed if a track is malformed
+    for (std::size_t i = 0; i < tracks.size(); i++)
+      {
+        if (!tracks[i]) return NULL;
       }
-    
-    //Close the file
-    fin.close();
-    } //IT AINT DONE YET FINISH IT UP*/
 
-  inline void freeLoadedMIDI(MIDI* mid) {delete mid;}
+    //Build the right kind of MIDI
+    if (type == 0) return new MIDI_Type0(std::move(tracks[0]), td);
+    else if (type == 1) return new MIDI_Type1(std::move(tracks), td);
+    else return new MIDI_Type2(std::move(tracks), td);
+  }
+
+  //Loads a midi file into the proper structure, returning a pointer to it.
+  //The file is memory mapped and meta and SysEx data refer directly into it.
+  //Returns NULL if the loading failed
+  //THIS MUST BE MANUALLY FREED BY THE USER WITH freeLoadedMIDI
+  MIDI* load(std::string filename)
+  {
+    std::shared_ptr<MappedFile> file(new MappedFile(filename));
+    if (!file->valid()) return NULL;
+    MIDI* mid = readMIDI(*file, NULL);
+
+    //Keep the mapping alive as long as the events refer into it
+    if (mid != NULL) mid->source_ = file;
+    return mid;
+  }
+
+  //Loads a midi file as above, decoding its tracks concurrently
+  MIDI* load(std::string filename, ThreadPool & pool)
+  {
+    std::shared_ptr<MappedFile> file(new MappedFile(filename));
+    if (!file->valid()) return NULL;
+    MIDI* mid = readMIDI(*file, &pool);
+    if (mid != NULL) mid->source_ = file;
+    return mid;
+  }
+
+  //Frees a MIDI returned by load
+  void freeLoadedMIDI(MIDI* mid) {delete mid;}
 
 } //Namespace
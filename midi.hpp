@@ -14,10 +14,13 @@
 
 #include "track.hpp"
 #include "timedivision.hpp"
+#include "mappedfile.hpp"
+#include "threadpool.hpp"
 
 #include <vector>
 #include <fstream>
 #include <string>
+#include <memory>
 
 namespace midi
 {
@@ -27,23 +30,56 @@ namespace midi
   public:
     virtual ~MIDI() {};
     virtual std::size_t size() const = 0;
-    void write(std::string filename) const;
-    virtual std::vector<std::uint8_t> data() const = 0;
+    virtual std::uint16_t type() const = 0;
+    //Writing returns false if the file or sink fails
+    bool write(std::string filename) const;
+    bool write(ByteSink & sink) const;
+    std::vector<std::uint8_t> data() const;
+
+    //Encodes the tracks concurrently, each into its own part of the output
+    std::vector<std::uint8_t> data(ThreadPool & pool) const;
+
     void setTimeDivision(const TimeDivision & td);
+    const TimeDivision & timeDivision() const {return td_;}
     virtual void clear() = 0;
+
+    //Read-only access to the tracks
+    virtual std::size_t numTracks() const = 0;
+    virtual const Track & track(std::size_t i) const = 0;
+
+    friend MIDI* load(std::string filename);
+    friend MIDI* load(std::string filename, ThreadPool & pool);
   protected:
+    //Writes the 14 byte file header
+    std::uint8_t* encodeHeader(std::uint8_t* out) const;
+
     TimeDivision td_;
+
+    //File the tracks' events refer into, if this was loaded from one
+    std::shared_ptr<MappedFile> source_;
   };
 
   class MIDI_Type0 : public MIDI
   {
   public:
     MIDI_Type0(const Track & tr, const TimeDivision & td);
+    MIDI_Type0(Track && tr, const TimeDivision & td);
+    MIDI_Type0(std::unique_ptr<Track> tr, const TimeDivision & td);
+    MIDI_Type0(const MIDI_Type0 & other);
+    MIDI_Type0(MIDI_Type0 && other);
+    MIDI_Type0 & operator=(const MIDI_Type0 & other);
+    MIDI_Type0 & operator=(MIDI_Type0 && other);
     ~MIDI_Type0();
     std::size_t size() const;
-    std::vector<std::uint8_t> data() const;
+    std::uint16_t type() const {return 0;}
     void setTrack(const Track & tr);
+    void setTrack(Track && tr);
+    void setTrack(std::unique_ptr<Track> tr);
     void clear();
+    std::size_t numTracks() const {return track_ != NULL ? 1 : 0;}
+
+    //A cleared or moved-from MIDI has no track, and gives an empty one here
+    const Track & track(std::size_t) const;
   private:
     Track* track_;
   };
@@ -51,32 +87,61 @@ namespace midi
   class MIDI_Type1 : public MIDI
   {
   public:
-    MIDI_Type1(const std::vector<Track*> & tr, const TimeDivision & td);
+    //The tracks in the vector are adopted, not copied
+    MIDI_Type1(std::vector<std::unique_ptr<Track> > tr, const TimeDivision & td);
     MIDI_Type1(const TimeDivision & td);
+    MIDI_Type1(const MIDI_Type1 & other);
+    MIDI_Type1(MIDI_Type1 && other);
+    MIDI_Type1 & operator=(const MIDI_Type1 & other);
+    MIDI_Type1 & operator=(MIDI_Type1 && other);
     ~MIDI_Type1();
     std::size_t size() const;
-    std::vector<std::uint8_t> data() const;
+    std::uint16_t type() const {return 1;}
     void addTrack(const Track & tr);
+    void addTrack(Track && tr);
+    void addTrack(std::unique_ptr<Track> tr);
     void clear();
+    std::size_t numTracks() const {return track_.size();}
+    const Track & track(std::size_t i) const {return *track_[i];}
+
+    //Places the events of tracks added from now on in one shared arena
+    void useArena(std::size_t blockSize = 65536);
   private:
+    //Appends copies of the tracks of another MIDI
+    void copyTracks(const MIDI_Type1 & other);
+
     std::vector<Track*> track_;
+    std::shared_ptr<EventArena> arena_;
   };
 
   class MIDI_Type2 : public MIDI
   {
   public:
-    MIDI_Type2(const std::vector<Track*> & tr, const TimeDivision & td);
+    //The tracks in the vector are adopted, not copied
+    MIDI_Type2(std::vector<std::unique_ptr<Track> > tr, const TimeDivision & td);
     MIDI_Type2(const TimeDivision & td);
+    MIDI_Type2(const MIDI_Type2 & other);
+    MIDI_Type2(MIDI_Type2 && other);
+    MIDI_Type2 & operator=(const MIDI_Type2 & other);
+    MIDI_Type2 & operator=(MIDI_Type2 && other);
     ~MIDI_Type2();
     std::size_t size() const;
-    std::vector<std::uint8_t> data() const;
+    std::uint16_t type() const {return 2;}
     void addTrack(const Track & tr);
+    void addTrack(Track && tr);
+    void addTrack(std::unique_ptr<Track> tr);
     void clear();
+    std::size_t numTracks() const {return track_.size();}
+    const Track & track(std::size_t i) const {return *track_[i];}
   private:
+    //Appends copies of the tracks of another MIDI
+    void copyTracks(const MIDI_Type2 & other);
+
     std::vector<Track*> track_;
   };
 
-  //MIDI* load(std::string filename); //IT'S NOT DONE YET. LOTS TO DO.
+  MIDI* load(std::string filename);
+  MIDI* load(std::string filename, ThreadPool & pool);
   void freeLoadedMIDI(MIDI* mid);
 
 } //Namespace
@@ -0,0 +1,313 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----MIDI Batch Converter-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Processes every MIDI file in a directory tree on all cores, validating,
+  loading, normalizing, converting to notes and writing each one, and
+  reports how fast it went.
+
+  Usage: midibatch [-j threads] [-o outdir] [-q] indir [operation...]
+  Operations: validate load normalize notes write
+*/
+
+#include "midi.hpp"
+#include "threadpool.hpp"
+#include "sink.hpp"
+#include "validator.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace midi;
+
+typedef std::chrono::steady_clock Clock;
+
+//What to do with each file, in this order
+struct Options
+{
+  Options() : threads(0), quiet(false), validate(false), normalize(false),
+              notes(false), write(false) {}
+
+  std::size_t threads;
+  bool quiet;
+  bool validate;
+  bool normalize;
+  bool notes;
+  bool write;
+  std::string input;
+  std::string output;
+};
+
+//Totals over every file
+struct Totals
+{
+  Totals() : files(0), failed(0), bytesIn(0), bytesOut(0), notes(0) {}
+
+  std::atomic<std::size_t> files;
+  std::atomic<std::size_t> failed;
+  std::atomic<std::size_t> bytesIn;
+  std::atomic<std::size_t> bytesOut;
+  std::atomic<std::size_t> notes;
+};
+
+static void usage()
+{
+  std::cerr << "Usage: midibatch [-j threads] [-o outdir] [-q] indir [operation...]" << std::endl
+            << "Operations, done in this order on each file:" << std::endl
+            << "  validate   check the file's structure before loading it" << std::endl
+            << "  load       only load the file (the default)" << std::endl
+            << "  normalize  reorder events within a tick into a canonical order" << std::endl
+            << "  notes      convert every track to notes" << std::endl
+            << "  write      write the result under outdir" << std::endl;
+}
+
+//Whether a file name ends in .mid or .midi, in any case
+static bool isMIDIName(const std::string & name)
+{
+  std::string lower(name);
+  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+  std::size_t dot = lower.rfind('.');
+  if (dot == std::string::npos) return false;
+  return lower.compare(dot, std::string::npos, ".mid") == 0 ||
+    lower.compare(dot, std::string::npos, ".midi") == 0;
+}
+
+//Appends the paths of every MIDI file under root/relative, relative to root
+static void findFiles(const std::string & root, const std::string & relative,
+                      std::vector<std::string> & files)
+{
+  std::string dirPath = relative.empty() ? root : root + "/" + relative;
+  DIR* dir = opendir(dirPath.c_str());
+  if (dir == NULL) return;
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL)
+    {
+      std::string name(entry->d_name);
+      if (name == "." || name == "..") continue;
+      std::string rel = relative.empty() ? name : relative + "/" + name;
+
+      //Links to directories aren't followed, since they can form loops
+      std::string path = root + "/" + rel;
+      struct stat info;
+      if (lstat(path.c_str(), &info) != 0) continue;
+      if (S_ISLNK(info.st_mode) && (stat(path.c_str(), &info) != 0 ||
+                                    S_ISDIR(info.st_mode))) continue;
+      if (S_ISDIR(info.st_mode)) findFiles(root, rel, files);
+      else if (S_ISREG(info.st_mode) && isMIDIName(name)) files.push_back(rel);
+    }
+  closedir(dir);
+}
+
+//Creates every directory leading up to a file
+static bool makeParents(const std::string & path)
+{
+  for (std::size_t slash = path.find('/', 1); slash != std::string::npos;
+       slash = path.find('/', slash + 1))
+    {
+      std::string dir = path.substr(0, slash);
+      if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) return false;
+    }
+  return true;
+}
+
+//A copy of a MIDI with every track normalized
+static MIDI* normalizeMIDI(const MIDI & mid)
+{
+  std::vector<std::unique_ptr<Track> > tracks;
+  for (std::size_t t = 0; t < mid.numTracks(); t++)
+    {
+      const EventTrack* track = dynamic_cast<const EventTrack*>(&mid.track(t));
+      if (track == NULL) tracks.push_back(std::unique_ptr<Track>(mid.track(t).clone()));
+      else tracks.push_back(std::unique_ptr<Track>(new EventTrack(track->normalized())));
+    }
+
+  if (mid.type() == 0) return new MIDI_Type0(std::move(tracks[0]), mid.timeDivision());
+  if (mid.type() == 1) return new MIDI_Type1(std::move(tracks), mid.timeDivision());
+  return new MIDI_Type2(std::move(tracks), mid.timeDivision());
+}
+
+//Writes all bytes to a new file
+static bool writeFile(const std::string & path, const std::vector<std::uint8_t> & data)
+{
+  if (!makeParents(path)) return false;
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) return false;
+  bool ok;
+  {
+    FileDescriptorSink sink(fd);
+    ok = sink.write(data.data(), data.size()) && sink.flush();
+  }
+  return (close(fd) == 0) && ok;
+}
+
+//Does every operation on one file, returning an error or an empty string
+static std::string processFile(const Options & opt, const std::string & relative,
+                               ThreadPool & pool, Totals & totals,
+                               std::size_t & bytes, std::size_t & notes)
+{
+  std::string path = opt.input + "/" + relative;
+  struct stat info;
+  if (stat(path.c_str(), &info) == 0) bytes = info.st_size;
+
+  //Damaged files are turned away before any events are built
+  if (opt.validate)
+    {
+      ValidationError err = validate(path);
+      if (!err.ok())
+        {
+          std::ostringstream msg;
+          msg << err.describe() << " at byte " << err.offset;
+          return msg.str();
+        }
+    }
+
+  //Big files have their tracks spread over workers with nothing else to do
+  std::unique_ptr<MIDI, void(*)(MIDI*)> mid(load(path, pool), freeLoadedMIDI);
+  if (!mid) return "load failed";
+  totals.bytesIn += bytes;
+
+  if (opt.normalize) mid.reset(normalizeMIDI(*mid));
+
+  if (opt.notes)
+    {
+      for (std::size_t t = 0; t < mid->numTracks(); t++)
+        {
+          const EventTrack* track = dynamic_cast<const EventTrack*>(&mid->track(t));
+          if (track != NULL) notes += track->toNotes().note().size();
+        }
+      totals.notes += notes;
+    }
+
+  if (opt.write)
+    {
+      std::vector<std::uint8_t> data = mid->data(pool);
+      if (!writeFile(opt.output + "/" + relative, data)) return "write failed";
+      totals.bytesOut += data.size();
+    }
+
+  return "";
+}
+
+//Megabytes per second, guarding against tiny times
+static double rate(std::size_t bytes, double seconds)
+{
+  return seconds > 0 ? bytes / seconds / 1e6 : 0;
+}
+
+int main(int argc, char** argv)
+{
+  //Read the options
+  Options opt;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg(argv[i]);
+      if (arg == "-j" && i + 1 < argc) opt.threads = std::strtoul(argv[++i], NULL, 10);
+      else if (arg == "-o" && i + 1 < argc) opt.output = argv[++i];
+      else if (arg == "-q") opt.quiet = true;
+      else if (arg == "-h" || arg == "--help")
+        {
+          usage();
+          return 0;
+        }
+      else if (!arg.empty() && arg[0] == '-')
+        {
+          usage();
+          return 2;
+        }
+      else args.push_back(arg);
+    }
+  if (args.empty())
+    {
+      usage();
+      return 2;
+    }
+  opt.input = args[0];
+  for (std::size_t i = 1; i < args.size(); i++)
+    {
+      if (args[i] == "load") continue;
+      else if (args[i] == "validate") opt.validate = true;
+      else if (args[i] == "normalize") opt.normalize = true;
+      else if (args[i] == "notes") opt.notes = true;
+      else if (args[i] == "write") opt.write = true;
+      else
+        {
+          std::cerr << "Unknown operation: " << args[i] << std::endl;
+          return 2;
+        }
+    }
+  if (opt.write && opt.output.empty())
+    {
+      std::cerr << "write needs an output directory (-o)" << std::endl;
+      return 2;
+    }
+
+  //Find the files, in a repeatable order
+  std::vector<std::string> files;
+  findFiles(opt.input, "", files);
+  std::sort(files.begin(), files.end());
+
+  ThreadPool pool(opt.threads);
+  Totals totals;
+  std::mutex outMutex;
+  Clock::time_point start = Clock::now();
+
+  pool.parallelFor(files.size(), [&](std::size_t i)
+                   {
+                     Clock::time_point fileStart = Clock::now();
+                     std::size_t bytes = 0;
+                     std::size_t notes = 0;
+                     std::string error = processFile(opt, files[i], pool, totals, bytes, notes);
+                     double seconds = std::chrono::duration<double>(Clock::now() - fileStart).count();
+
+                     totals.files++;
+                     if (!error.empty()) totals.failed++;
+                     if (opt.quiet && error.empty()) return;
+
+                     //Lines are built first so threads don't interleave them
+                     std::ostringstream line;
+                     line << (error.empty() ? "ok     " : "FAILED ") << files[i] << "  "
+                          << bytes << " bytes  " << std::fixed << std::setprecision(3)
+                          << seconds * 1000 << " ms  " << std::setprecision(1)
+                          << rate(bytes, seconds) << " MB/s";
+                     if (opt.notes) line << "  " << notes << " notes";
+                     if (!error.empty()) line << "  (" << error << ")";
+                     std::lock_guard<std::mutex> lock(outMutex);
+                     std::cout << line.str() << std::endl;
+                   });
+
+  //Aggregate report
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << std::endl << totals.files << " files, " << totals.failed << " failed, "
+            << pool.size() << " threads" << std::endl
+            << std::fixed << std::setprecision(3) << seconds << " s, "
+            << std::setprecision(1) << (seconds > 0 ? totals.files / seconds : 0)
+            << " files/s, " << rate(totals.bytesIn, seconds) << " MB/s read";
+  if (opt.write) std::cout << ", " << rate(totals.bytesOut, seconds) << " MB/s written";
+  if (opt.notes) std::cout << ", " << totals.notes << " notes";
+  std::cout << std::endl;
+
+  return totals.failed > 0 ? 1 : 0;
+}
@@ -14,113 +14,9 @@
 namespace midi
 {
 
-  //Default constructor sets the internal note to 0, the lowest MIDI note
-  Note::Note() : number_(0) {}
-
   //Takes in a note in format [Note][Octave] (C4, D#2, Bb6)
-  Note::Note(const std::string& notation)
-  {
-    //Extract components and verify size and input
-    std::int8_t note, mod, octave;
-    std::int8_t unused = -2;
-  
-    note = notation[0];
-    if (notation.size() == 2)
-      {
-        octave = notation[1] - '0';
-        mod = unused;
-      }
-    else if (notation.size() == 3)
-      {
-        //Two cases, _10 or _[#b]_
-        if (notation[1] == '1')
-          {
-            if (notation[2] != '0')
-              {
-                number_ = 0;
-                return;
-              }
-            else octave = 10;
-            mod = unused;
-          }
-        else if (notation[1] == '#' || notation[1] == 'b')
-          {
-            mod = notation[1];
-            octave = notation[2] - '0';
-          }
-        else
-          {
-            number_ = 0;
-            return;
-          }
-      }
-    else if (notation.size() == 4)
-      {
-        if (notation[2] != '1' || notation[3] != '0')
-          {
-            number_ = 0;
-            return;
-          }
-        mod = notation[1];
-        octave = 10;
-      }
-    else
-      {
-        number_ = 0;
-        return;
-      }
-  
-    //Convert lower case note to upper case
-    if (note > 'Z' || note < 'A') note -= 'a'-'A';
-
-    //Lowest note is C, not A
-    if (note < 'C') note += 'H'-'A';
-
-    //Make room for the various sharps and flats
-    std::int8_t newnote = note;
-    if (note > 'C') newnote++;
-    if (note > 'D') newnote++;
-    if (note > 'F') newnote++;
-    if (note > 'G') newnote++;
-    if (note > 'H') newnote++;
-    note = newnote;
-
-    //Find any modification from sharp or flat
-    if (mod != unused)
-      {
-        switch (mod)
-          {
-          case 'b': if (note != 0) note--;
-            break;
-          case '#': if (note != 127) note++;
-            break;
-          default: break;
-          }
-      }
-
-    //Verify that the octave is a reasonable number
-    if (octave < 0 || octave > 10)
-      {
-        number_ = 0;
-        return;
-      }
-
-    //Finally, convert to midi number
-    number_ = (note - 'C') + (12 * octave);
-  }
-
-  //Takes in a note as a string
-  Note::Note(const char* notation)
-  {
-    std::string str(notation);
-    *this = Note(str);
-  }
-
-  //Takes in a note as a midi number
-  Note::Note(std::int8_t innumber) : number_(innumber) {}
-
-  //Takes in a note as a midi number
-  Note::Note(int innumber) : number_(innumber) {}
+  Note::Note(const std::string& notation) :
+    number_(parse(notation.c_str(), notation.size())) {}
 
   //Returns the data in format [Note][Octave]
   std::string Note::val() const
@@ -142,58 +38,82 @@ namespace midi
     return val();
   }
 
-  //Returns the note as a midi number
-  std::int8_t Note::midiVal() const
-  {
-    return number_;
-  }
-
-  //Typecast to int8_t
-  Note::operator std::int8_t() const
+  //Helpers for the bits of a Chord
+  //Index of the lowest set bit of a nonzero number
+  static int lowestBit(std::uint64_t bits)
   {
-    return midiVal();
+#ifdef __GNUC__
+    return __builtin_ctzll(bits);
+#else
+    int ret = 0;
+    while (!(bits & 1))
+      {
+        bits >>= 1;
+        ret++;
+      }
+    return ret;
+#endif
   }
 
-  //Note operators
-  bool operator==(const Note& n1, const Note& n2)
+  //Number of set bits
+  static std::size_t countBits(std::uint64_t bits)
   {
-    return n1.midiVal() == n2.midiVal();
+#ifdef __GNUC__
+    return __builtin_popcountll(bits);
+#else
+    std::size_t ret = 0;
+    for (; bits != 0; bits &= bits - 1) ret++;
+    return ret;
+#endif
   }
 
-  bool operator!=(const Note& n1, const Note& n2)
+  //Chord::NoteView functions
+  Note Chord::NoteView::const_iterator::operator*() const
   {
-    return n1.midiVal() != n2.midiVal();
+    if (low_ != 0) return Note(lowestBit(low_));
+    return Note(64 + lowestBit(high_));
   }
 
-  bool operator==(const Note& n1, const int& n2)
+  //Moves on by clearing the lowest note
+  Chord::NoteView::const_iterator & Chord::NoteView::const_iterator::operator++()
   {
-    return n1.midiVal() == n2;
+    if (low_ != 0) low_ &= low_ - 1;
+    else high_ &= high_ - 1;
+    return *this;
   }
 
-  bool operator!=(const Note& n1, const int& n2)
+  Chord::NoteView::const_iterator Chord::NoteView::const_iterator::operator++(int)
   {
-    return n1.midiVal() != n2;
+    const_iterator ret = *this;
+    ++*this;
+    return ret;
   }
 
-  bool operator==(const int& n1, const Note& n2)
+  std::size_t Chord::NoteView::size() const
   {
-    return n1 == n2.midiVal();
+    return countBits(low_) + countBits(high_);
   }
 
-  bool operator!=(const int& n1, const Note& n2)
+  //Adds one note, returning false if it was already there or isn't a MIDI note
+  bool Chord::insert(const Note n)
   {
-    return n1 != n2.midiVal();
+    int val = n.midiVal();
+    if (val < 0) return false;
+    std::uint64_t & bits = (val < 64) ? low_ : high_;
+    std::uint64_t bit = std::uint64_t(1) << (val & 63);
+    if (bits & bit) return false;
+    bits |= bit;
+    return true;
   }
 
-  //Default constructor does nothing!
-  Chord::Chord() {};
-
-  //Standard constructor allows for up to five initial notes
-  Chord::Chord(const Note n1, const Note n2, const Note n3,
-               const Note n4, const Note n5)
+  //Removes one note, returning false if it wasn't there
+  bool Chord::erase(const Note n)
   {
-    //Just add all five
-    add(n1, n2, n3, n4, n5);
+    if (!contains(n)) return false;
+    int val = n.midiVal();
+    std::uint64_t & bits = (val < 64) ? low_ : high_;
+    bits &= ~(std::uint64_t(1) << (val & 63));
+    return true;
   }
 
   //Adds the given notes. Returns true only if all were added properly
@@ -203,13 +123,13 @@ namespace midi
     bool ret = true;
 
     //Always try to insert n1
-    if (!(note_.insert(n1).second)) ret = false;
+    if (!insert(n1)) ret = false;
 
     //Only insert the others if they aren't -1
-    if (n2 != -1) if (!(note_.insert(n2).second)) ret = false;
-    if (n3 != -1) if (!(note_.insert(n3).second)) ret = false;
-    if (n4 != -1) if (!(note_.insert(n4).second)) ret = false;
-    if (n5 != -1) if (!(note_.insert(n5).second)) ret = false;
+    if (n2 != -1) if (!insert(n2)) ret = false;
+    if (n3 != -1) if (!insert(n3)) ret = false;
+    if (n4 != -1) if (!insert(n4)) ret = false;
+    if (n5 != -1) if (!insert(n5)) ret = false;
 
     return ret;
   }
@@ -221,13 +141,13 @@ namespace midi
     bool ret = true;
   
     //Always try to remove n1
-    if (note_.erase(n1) == 0) ret = false;
+    if (!erase(n1)) ret = false;
 
     //Only erase the others if they aren't -1
-    if (n2 != -1) if (note_.erase(n2) == 0) ret = false;
-    if (n3 != -1) if (note_.erase(n3) == 0) ret = false;
-    if (n4 != -1) if (note_.erase(n4) == 0) ret = false;
-    if (n5 != -1) if (note_.erase(n5) == 0) ret = false;
+    if (n2 != -1) if (!erase(n2)) ret = false;
+    if (n3 != -1) if (!erase(n3)) ret = false;
+    if (n4 != -1) if (!erase(n4)) ret = false;
+    if (n5 != -1) if (!erase(n5)) ret = false;
 
     return ret;
   }
@@ -235,13 +155,54 @@ namespace midi
   //Returns true only if the given note is contained in the chord
   bool Chord::contains(const Note innote) const
   {
-    return note_.find(innote) != note_.end();
+    int val = innote.midiVal();
+    if (val < 0) return false;
+    std::uint64_t bits = (val < 64) ? low_ : high_;
+    return (bits >> (val & 63)) & 1;
+  }
+
+  Chord& Chord::operator|=(const Chord & c)
+  {
+    low_ |= c.low_;
+    high_ |= c.high_;
+    return *this;
+  }
+
+  Chord& Chord::operator&=(const Chord & c)
+  {
+    low_ &= c.low_;
+    high_ &= c.high_;
+    return *this;
   }
 
-  //Returns the set for viewing
-  const std::set<Note>& Chord::notes() const
+  //Shifts the 128 bits of notes up or down
+  Chord Chord::transpose(int semitones) const
   {
-    return note_;
+    Chord ret;
+    if (semitones >= 128 || semitones <= -128) return ret;
+    if (semitones >= 64)
+      {
+        ret.high_ = low_ << (semitones - 64);
+      }
+    else if (semitones > 0)
+      {
+        ret.high_ = (high_ << semitones) | (low_ >> (64 - semitones));
+        ret.low_ = low_ << semitones;
+      }
+    else if (semitones == 0)
+      {
+        ret = *this;
+      }
+    else if (semitones > -64)
+      {
+        ret.low_ = (low_ >> -semitones) | (high_ << (64 + semitones));
+        ret.high_ = high_ >> -semitones;
+      }
+    else
+      {
+        ret.low_ = high_ >> (-semitones - 64);
+      }
+    return ret;
   }
 
 } //Namespace
@@ -13,8 +13,8 @@
 #define _note_hpp_
 
 #include <string>
-#include <set>
 #include <cstdint>
+#include <cstddef>
 
 namespace midi
 {
@@ -26,37 +26,120 @@ namespace midi
   {
   public:
     //Constructors
-    Note();
+    //Notation is in format [Note][Octave] (C4, D#2, Bb6). Anything else is note 0.
+    constexpr Note() : number_(0) {}
     Note(const std::string& notation);
-    Note(std::int8_t innumber);
-    Note(const char* notation);
-    Note(int innumber);
+    constexpr Note(std::int8_t innumber) : number_(innumber) {}
+    constexpr Note(const char* notation) : number_(parse(notation, length(notation))) {}
+    constexpr Note(const char* notation, std::size_t size) : number_(parse(notation, size)) {}
+    constexpr Note(int innumber) : number_(innumber) {}
 
     //Get the data in different formats
     std::string val() const;
     operator std::string() const;
-    std::int8_t midiVal() const;
-    operator std::int8_t() const;
+    constexpr std::int8_t midiVal() const {return number_;}
+    constexpr operator std::int8_t() const {return number_;}
   
   private:
+    //Parsing of notation, usable at compile time
+    static constexpr std::size_t length(const char* str)
+    {
+      return *str ? 1 + length(str + 1) : 0;
+    }
+
+    //Returns the MIDI number for a note, modifier ('#', 'b', or none) and octave
+    static constexpr std::int8_t build(char note, char mod, int octave)
+    {
+      return (octave < 0 || octave > 10) ? 0 :
+        std::int8_t(semitone(letter(note)) + (mod == '#') - (mod == 'b') + 12*octave);
+    }
+
+    //Converts lower case notes to upper case
+    static constexpr int upper(int note)
+    {
+      return (note > 'Z' || note < 'A') ? note - ('a'-'A') : note;
+    }
+
+    //Upper case letter, with A and B moved above G since octaves begin at C
+    static constexpr int letter(int note)
+    {
+      return upper(note) < 'C' ? upper(note) + ('H'-'A') : upper(note);
+    }
+
+    //Semitones above C, making room for the sharps and flats
+    static constexpr int semitone(int note)
+    {
+      return note - 'C' + (note > 'C') + (note > 'D') + (note > 'F') + (note > 'G') + (note > 'H');
+    }
+
+    //Splits the notation apart by its length
+    static constexpr std::int8_t parse(const char* str, std::size_t size)
+    {
+      return size == 2 ? build(str[0], 0, str[1] - '0') :
+        size == 3 ? (str[1] == '1' ? (str[2] == '0' ? build(str[0], 0, 10) : 0) :
+                     (str[1] == '#' || str[1] == 'b') ? build(str[0], str[1], str[2] - '0') : 0) :
+        size == 4 ? ((str[2] == '1' && str[3] == '0') ? build(str[0], str[1], 10) : 0) :
+        0;
+    }
+
     std::int8_t number_;
   };
 
+  //Note literal, as in "C#4"_note
+  constexpr Note operator"" _note(const char* notation, std::size_t size)
+  {
+    return Note(notation, size);
+  }
+
   //Note operators
-  bool operator==(const Note& n1, const Note& n2);
-  bool operator!=(const Note& n1, const Note& n2);
-  bool operator==(const Note& n1, const int& n2);
-  bool operator!=(const Note& n1, const int& n2);
-  bool operator==(const int& n1, const Note& n2);
-  bool operator!=(const int& n1, const Note& n2);
+  constexpr bool operator==(const Note& n1, const Note& n2) {return n1.midiVal() == n2.midiVal();}
+  constexpr bool operator!=(const Note& n1, const Note& n2) {return n1.midiVal() != n2.midiVal();}
+  constexpr bool operator==(const Note& n1, const int& n2) {return n1.midiVal() == n2;}
+  constexpr bool operator!=(const Note& n1, const int& n2) {return n1.midiVal() != n2;}
+  constexpr bool operator==(const int& n1, const Note& n2) {return n1 == n2.midiVal();}
+  constexpr bool operator!=(const int& n1, const Note& n2) {return n1 != n2.midiVal();}
 
+  //A set of notes, stored as one bit per MIDI note
   class Chord
   {
   public:
-    //Constructors
-    Chord();
-    Chord(const Note n1, const Note n2 = -1, const Note n3 = -1,
-          const Note n4 = -1, const Note n5 = -1);
+    //Read-only view of the notes of a chord, lowest first
+    class NoteView
+    {
+    public:
+      class const_iterator
+      {
+      public:
+        const_iterator(std::uint64_t low, std::uint64_t high) : low_(low), high_(high) {}
+        Note operator*() const;
+        const_iterator & operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator & it) const
+        {return low_ == it.low_ && high_ == it.high_;}
+        bool operator!=(const const_iterator & it) const {return !(*this == it);}
+      private:
+        //Notes not yet visited
+        std::uint64_t low_;
+        std::uint64_t high_;
+      };
+
+      NoteView(std::uint64_t low, std::uint64_t high) : low_(low), high_(high) {}
+      const_iterator begin() const {return const_iterator(low_, high_);}
+      const_iterator end() const {return const_iterator(0, 0);}
+      std::size_t size() const;
+      bool empty() const {return (low_ | high_) == 0;}
+    private:
+      std::uint64_t low_;
+      std::uint64_t high_;
+    };
+    typedef NoteView::const_iterator const_iterator;
+
+    //Constructors, allowing for up to five initial notes
+    constexpr Chord() : low_(0), high_(0) {}
+    constexpr Chord(const Note n1, const Note n2 = -1, const Note n3 = -1,
+                    const Note n4 = -1, const Note n5 = -1) :
+      low_(bit(n1, 0) | bit(n2, 0) | bit(n3, 0) | bit(n4, 0) | bit(n5, 0)),
+      high_(bit(n1, 64) | bit(n2, 64) | bit(n3, 64) | bit(n4, 64) | bit(n5, 64)) {}
 
     //Note operations
     bool add(const Note n1, const Note n2 = -1, const Note n3 = -1,
@@ -64,12 +147,42 @@ namespace midi
     bool remove(const Note n1, const Note n2 = -1, const Note n3 = -1,
                 const Note n4 = -1, const Note n5 = -1);
     bool contains(const Note innote) const;
+    std::size_t size() const {return notes().size();}
+
+    //Combining chords
+    constexpr Chord operator|(const Chord & c) const {return Chord(Bits(), low_ | c.low_, high_ | c.high_);}
+    constexpr Chord operator&(const Chord & c) const {return Chord(Bits(), low_ & c.low_, high_ & c.high_);}
+    Chord& operator|=(const Chord & c);
+    Chord& operator&=(const Chord & c);
+    constexpr bool operator==(const Chord & c) const {return low_ == c.low_ && high_ == c.high_;}
+    constexpr bool operator!=(const Chord & c) const {return !(*this == c);}
+
+    //Moves every note by the given number of semitones, dropping any which
+    //leave the range of MIDI notes
+    Chord transpose(int semitones) const;
 
     //Accessor, just for viewing
-    const std::set<Note>& notes() const;
+    NoteView notes() const {return NoteView(low_, high_);}
   
   private:
-    std::set<Note> note_;
+    //The bit for a note within the word of notes starting at first, if it's there
+    static constexpr std::uint64_t bit(const Note n, int first)
+    {
+      return (n.midiVal() >= first && n.midiVal() < first + 64) ?
+        std::uint64_t(1) << (n.midiVal() - first) : 0;
+    }
+
+    //Straight from the bits, tagged to keep this apart from the note constructor
+    struct Bits {};
+    constexpr Chord(Bits, std::uint64_t low, std::uint64_t high) : low_(low), high_(high) {}
+
+    //Adds or removes one note, returning false if nothing changed
+    bool insert(const Note n);
+    bool erase(const Note n);
+
+    //Notes 0-63 and 64-127
+    std::uint64_t low_;
+    std::uint64_t high_;
   };
 
 } //Namespace
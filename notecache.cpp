@@ -0,0 +1,536 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----NoteCache Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the NoteCache class, a columnar file format
+  for the notes of a MIDI.
+*/
+
+#include "notecache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+namespace midi
+{
+
+  //Start of the file. The track table follows at ALIGN bytes.
+  struct CacheHeader
+  {
+    char magic[4];
+    std::uint32_t byteOrder;
+    std::uint32_t version;
+    std::uint16_t type;
+    std::uint8_t division[2];
+    std::uint64_t numTracks;
+    std::uint64_t size;
+  };
+
+  //Where the sections of one track are, as offsets from the start of the file
+  struct CacheTrack
+  {
+    std::uint64_t notes;
+    std::uint64_t column[NoteCache::COLUMNS];
+    std::uint64_t metaOffset;
+    std::uint64_t metaSize;
+    std::uint64_t eventsOffset;
+    std::uint64_t eventsSize;
+    std::uint64_t orderOffset;
+    std::uint64_t orderSize;
+  };
+
+  static const char MAGIC[4] = {'M', 'I', 'D', 'C'};
+  static const std::uint32_t ORDER_MARK = 0x01020304;
+  static const std::uint32_t VERSION = 2;
+  static const std::size_t ALIGN = 64;
+
+  //Rounds an offset up to the next section boundary
+  static std::size_t alignUp(std::size_t offset)
+  {
+    return (offset + ALIGN - 1) & ~(ALIGN - 1);
+  }
+
+  //Reads a track's table entry, which may not be aligned for the struct
+  static CacheTrack readTrackEntry(const std::uint8_t* data, std::size_t track)
+  {
+    CacheTrack entry;
+    std::memcpy(&entry, data + ALIGN + track * sizeof(CacheTrack), sizeof(CacheTrack));
+    return entry;
+  }
+
+  //Everything one track turns into, before it's laid out
+  struct CacheSections
+  {
+    std::vector<std::uint8_t> column[NoteCache::COLUMNS];
+    std::vector<std::uint8_t> meta;
+    std::vector<std::uint8_t> events;
+    std::vector<std::uint8_t> order;
+    std::size_t notes;
+  };
+
+  //Appends a 32 bit value in the machine's byte order
+  static void appendWord(std::vector<std::uint8_t> & out, std::uint32_t value)
+  {
+    std::uint8_t bytes[4];
+    std::memcpy(bytes, &value, 4);
+    out.insert(out.end(), bytes, bytes + 4);
+  }
+
+  //Pairs the Note On and Note Off events of a track into columns, putting
+  //everything else in the meta and event sections
+  static void splitTrack(const Track & track, CacheSections & out)
+  {
+    CompactTrack ct(track);
+
+    //Notes sounding on each channel and key are kept in a list, oldest first,
+    //so every Note Off ends the earliest note it can, as in EventTrack::toNotes
+    const std::uint32_t none = 0xFFFFFFFF;
+    struct Pending
+    {
+      std::uint32_t event;
+      std::uint32_t offEvent;
+      std::uint32_t begin;
+      std::uint32_t duration;
+      std::uint8_t release;
+      std::uint8_t program;
+      bool ended;
+    };
+    std::vector<Pending> notes;
+    std::vector<std::uint32_t> next;
+    std::vector<std::uint32_t> first(16*128, none);
+    std::vector<std::uint32_t> last(16*128, none);
+    std::uint8_t program[16] = {0};
+
+    //Each event's tick, and its position among the events of that tick
+    std::vector<std::uint32_t> tick(ct.count());
+    std::vector<std::uint32_t> order(ct.count());
+    std::vector<bool> residual(ct.count(), false);
+    std::uint32_t totalTime = 0;
+    for (std::size_t i = 0; i < ct.count(); i++)
+      {
+        const CompactEvent & ev = ct.event()[i];
+        totalTime += ev.deltaTime;
+        tick[i] = totalTime;
+        order[i] = (i > 0 && ev.deltaTime == 0) ? order[i-1] + 1 : 0;
+        if (ev.status == 0xFF) continue;
+
+        std::uint8_t kind = ev.status >> 4;
+        std::uint8_t chan = ev.status & 0x0F;
+        if (kind == 0x0C && ev.status < 0xF0) program[chan] = ev.param1;
+        if (kind != 0x08 && kind != 0x09)
+          {
+            residual[i] = true;
+            continue;
+          }
+
+        std::size_t key = chan*128 + ev.param1;
+        if (kind == 0x09 && ev.param2 != 0)
+          {
+            //Note On opens a note at the end of its key's list
+            Pending p = {std::uint32_t(i), none, totalTime, 0, 0, program[chan], false};
+            std::uint32_t index = notes.size();
+            notes.push_back(p);
+            next.push_back(none);
+            if (last[key] == none) first[key] = index;
+            else next[last[key]] = index;
+            last[key] = index;
+            continue;
+          }
+
+        //Note Off ends the note at the front, and stays an event if none is
+        std::uint32_t index = first[key];
+        if (index == none)
+          {
+            residual[i] = true;
+            continue;
+          }
+        notes[index].offEvent = i;
+        notes[index].duration = totalTime - notes[index].begin;
+        notes[index].release = (kind == 0x09) ? 0xFF : ev.param2;
+        notes[index].ended = true;
+        first[key] = next[index];
+        if (first[key] == none) last[key] = none;
+      }
+
+    //Notes which never ended stay as Note On events
+    out.notes = 0;
+    for (std::size_t n = 0; n < notes.size(); n++)
+      {
+        const Pending & p = notes[n];
+        if (!p.ended)
+          {
+            residual[p.event] = true;
+            continue;
+          }
+        const CompactEvent & on = ct.event()[p.event];
+        appendWord(out.column[NoteCache::BEGIN], p.begin);
+        appendWord(out.column[NoteCache::DURATION], p.duration);
+        out.column[NoteCache::PITCH].push_back(on.param1);
+        out.column[NoteCache::VELOCITY].push_back(on.param2);
+        out.column[NoteCache::RELEASE].push_back(p.release);
+        out.column[NoteCache::CHANNEL].push_back(on.status & 0x0F);
+        out.column[NoteCache::INSTRUMENT].push_back(p.program);
+        appendWord(out.column[NoteCache::ON_ORDER], order[p.event]);
+        appendWord(out.column[NoteCache::OFF_ORDER], order[p.offEvent]);
+        out.notes++;
+      }
+
+    //The rest keep their order, with delta times within their own section
+    CompactTrack meta;
+    CompactTrack events;
+    std::vector<std::uint8_t> eventOrder;
+    std::uint32_t lastMeta = 0;
+    std::uint32_t lastEvent = 0;
+    out.order.clear();
+    for (std::size_t i = 0; i < ct.count(); i++)
+      {
+        const CompactEvent & ev = ct.event()[i];
+        if (ev.status == 0xFF)
+          {
+            meta.addMeta(tick[i] - lastMeta, ev.param1, ct.payload(i), ev.length);
+            appendWord(out.order, order[i]);
+            lastMeta = tick[i];
+          }
+        else if (residual[i])
+          {
+            if (ev.status >= 0xF0)
+              events.addSysEx(tick[i] - lastEvent, ev.status, ct.payload(i), ev.length);
+            else events.addChannel(tick[i] - lastEvent, ev.status, ev.param1, ev.param2);
+            appendWord(eventOrder, order[i]);
+            lastEvent = tick[i];
+          }
+      }
+    out.meta = meta.data();
+    out.events = events.data();
+    out.order.insert(out.order.end(), eventOrder.begin(), eventOrder.end());
+  }
+
+  //Encodes a MIDI into the cache format
+  std::vector<std::uint8_t> NoteCache::encode(const MIDI & mid)
+  {
+    std::size_t numTracks = mid.numTracks();
+    std::vector<CacheSections> sections(numTracks);
+    for (std::size_t t = 0; t < numTracks; t++)
+      {
+        splitTrack(mid.track(t), sections[t]);
+      }
+
+    //Lay out every section
+    std::vector<CacheTrack> entry(numTracks);
+    std::size_t offset = ALIGN + numTracks * sizeof(CacheTrack);
+    for (std::size_t t = 0; t < numTracks; t++)
+      {
+        entry[t].notes = sections[t].notes;
+        for (std::size_t c = 0; c < COLUMNS; c++)
+          {
+            offset = alignUp(offset);
+            entry[t].column[c] = offset;
+            offset += sections[t].column[c].size();
+          }
+        offset = alignUp(offset);
+        entry[t].metaOffset = offset;
+        entry[t].metaSize = sections[t].meta.size();
+        offset = alignUp(offset + entry[t].metaSize);
+        entry[t].eventsOffset = offset;
+        entry[t].eventsSize = sections[t].events.size();
+        offset = alignUp(offset + entry[t].eventsSize);
+        entry[t].orderOffset = offset;
+        entry[t].orderSize = sections[t].order.size();
+        offset += entry[t].orderSize;
+      }
+
+    //Then fill them in
+    std::vector<std::uint8_t> out(alignUp(offset), 0);
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, 4);
+    header.byteOrder = ORDER_MARK;
+    header.version = VERSION;
+    header.type = mid.type();
+    std::vector<std::uint8_t> td = mid.timeDivision().data();
+    header.division[0] = td[0];
+    header.division[1] = td[1];
+    header.numTracks = numTracks;
+    header.size = out.size();
+    std::memcpy(&out[0], &header, sizeof(header));
+
+    for (std::size_t t = 0; t < numTracks; t++)
+      {
+        std::memcpy(&out[ALIGN + t * sizeof(CacheTrack)], &entry[t], sizeof(CacheTrack));
+        for (std::size_t c = 0; c < COLUMNS; c++)
+          {
+            const std::vector<std::uint8_t> & col = sections[t].column[c];
+            if (!col.empty()) std::memcpy(&out[entry[t].column[c]], &col[0], col.size());
+          }
+        std::memcpy(&out[entry[t].metaOffset], &sections[t].meta[0], entry[t].metaSize);
+        std::memcpy(&out[entry[t].eventsOffset], &sections[t].events[0], entry[t].eventsSize);
+        const std::vector<std::uint8_t> & order = sections[t].order;
+        if (!order.empty()) std::memcpy(&out[entry[t].orderOffset], &order[0], order.size());
+      }
+
+    return out;
+  }
+
+  //Writes the encoding to a sink
+  bool NoteCache::write(const MIDI & mid, ByteSink & sink)
+  {
+    std::vector<std::uint8_t> out = encode(mid);
+    return sink.write(&out[0], out.size()) && sink.flush();
+  }
+
+  //Writes the encoding to a file
+  bool NoteCache::write(const MIDI & mid, const std::string & filename)
+  {
+    std::ofstream fout(filename.c_str(), std::ios_base::out |
+                       std::ios_base::trunc |
+                       std::ios_base::binary);
+    if (!fout) return false;
+    StreamSink sink(fout);
+    return write(mid, sink);
+  }
+
+  //Constructors
+  NoteCache::NoteCache(const std::string & filename) :
+    file_(new MappedFile(filename)), data_(NULL), size_(0), valid_(false)
+  {
+    if (!file_->valid()) return;
+    data_ = file_->data();
+    size_ = file_->size();
+    valid_ = check();
+  }
+
+  NoteCache::NoteCache(const std::uint8_t* data, std::size_t size) :
+    data_(data), size_(size), valid_(false)
+  {
+    valid_ = check();
+  }
+
+  //Makes sure nothing in the header or table points outside the file, so
+  //the accessors never have to
+  bool NoteCache::check() const
+  {
+    if (data_ == NULL || size_ < ALIGN) return false;
+    if (reinterpret_cast<std::uintptr_t>(data_) % 8 != 0) return false;
+
+    CacheHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, 4) != 0) return false;
+    if (header.byteOrder != ORDER_MARK || header.version != VERSION) return false;
+    if (header.size != size_ || header.type > 2) return false;
+    if (header.numTracks > (size_ - ALIGN) / sizeof(CacheTrack)) return false;
+
+    for (std::size_t t = 0; t < header.numTracks; t++)
+      {
+        CacheTrack entry = readTrackEntry(data_, t);
+        if (entry.notes > size_) return false;
+        for (std::size_t c = 0; c < COLUMNS; c++)
+          {
+            std::size_t w = width(Column(c));
+            if (entry.column[c] % w != 0 || entry.column[c] > size_) return false;
+            if (entry.notes * w > size_ - entry.column[c]) return false;
+          }
+        if (entry.metaOffset > size_ || entry.metaSize > size_ - entry.metaOffset) return false;
+        if (entry.eventsOffset > size_ || entry.eventsSize > size_ - entry.eventsOffset) return false;
+        if (entry.orderOffset > size_ || entry.orderSize > size_ - entry.orderOffset) return false;
+        if (entry.metaSize < 8 || entry.eventsSize < 8) return false;
+        if (entry.orderOffset % 4 != 0 || entry.orderSize % 4 != 0) return false;
+      }
+
+    return true;
+  }
+
+  //File information
+  std::uint16_t NoteCache::type() const
+  {
+    if (!valid_) return 0;
+    CacheHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    return header.type;
+  }
+
+  TimeDivision NoteCache::timeDivision() const
+  {
+    TimeDivision td;
+    if (!valid_) return td;
+    CacheHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    td.setRaw(header.division[0], header.division[1]);
+    return td;
+  }
+
+  std::size_t NoteCache::numTracks() const
+  {
+    if (!valid_) return 0;
+    CacheHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    return header.numTracks;
+  }
+
+  //Columns
+  std::size_t NoteCache::notes(std::size_t track) const
+  {
+    if (track >= numTracks()) return 0;
+    return readTrackEntry(data_, track).notes;
+  }
+
+  const void* NoteCache::column(std::size_t track, Column col) const
+  {
+    if (track >= numTracks() || col >= COLUMNS) return NULL;
+    return data_ + readTrackEntry(data_, track).column[col];
+  }
+
+  //Other sections
+  bool NoteCache::section(std::size_t track, bool meta, CompactTrack & out) const
+  {
+    out.clear();
+    if (track >= numTracks()) return false;
+    CacheTrack entry = readTrackEntry(data_, track);
+    const std::uint8_t* chunk = data_ + (meta ? entry.metaOffset : entry.eventsOffset);
+    std::size_t size = meta ? entry.metaSize : entry.eventsSize;
+
+    //The chunk header has to agree with the table
+    std::size_t length = (std::size_t(chunk[4]) << 24) | (std::size_t(chunk[5]) << 16) |
+      (std::size_t(chunk[6]) << 8) | chunk[7];
+    if (std::memcmp(chunk, "MTrk", 4) != 0 || length != size - 8 ||
+        !out.read(chunk + 8, chunk + size))
+      {
+        out.clear();
+        return false;
+      }
+    return true;
+  }
+
+  CompactTrack NoteCache::meta(std::size_t track) const
+  {
+    CompactTrack ct;
+    section(track, true, ct);
+    return ct;
+  }
+
+  CompactTrack NoteCache::events(std::size_t track) const
+  {
+    CompactTrack ct;
+    section(track, false, ct);
+    return ct;
+  }
+
+  //Conversion to NoteTrack
+  NoteTrack NoteCache::toNotes(std::size_t track) const
+  {
+    NoteTrack nt;
+    std::size_t count = notes(track);
+    const std::uint32_t* b = begin(track);
+    const std::uint32_t* d = duration(track);
+    const std::uint8_t* p = pitch(track);
+    const std::uint8_t* ins = instrument(track);
+    for (std::size_t i = 0; i < count; i++)
+      {
+        nt.add(Note(int(p[i])), b[i], d[i], static_cast<Instrument>(ins[i] & 0x7F));
+      }
+    return nt;
+  }
+
+  //Rebuilds every track by merging its sections back together
+  MIDI* NoteCache::toMIDI() const
+  {
+    if (!valid_) return NULL;
+
+    //Every event goes back to its tick and its position within that tick
+    enum Kind {META, EVENT, ON, OFF};
+    struct Item
+    {
+      std::uint32_t tick;
+      std::uint32_t order;
+      std::uint8_t kind;
+      std::uint32_t index;
+    };
+
+    std::vector<std::unique_ptr<Track> > tracks;
+    for (std::size_t t = 0; t < numTracks(); t++)
+      {
+        CompactTrack meta;
+        CompactTrack events;
+        if (!section(t, true, meta) || !section(t, false, events)) return NULL;
+        std::size_t count = notes(t);
+        const std::uint32_t* b = begin(t);
+        const std::uint32_t* d = duration(t);
+        const std::uint32_t* onOrd = onOrder(t);
+        const std::uint32_t* offOrd = offOrder(t);
+
+        //The residual order has an entry for each meta event, then each other
+        CacheTrack entry = readTrackEntry(data_, t);
+        if (entry.orderSize != 4 * (meta.count() + events.count())) return NULL;
+        const std::uint32_t* order = reinterpret_cast<const std::uint32_t*>(data_ + entry.orderOffset);
+
+        std::vector<Item> item;
+        item.reserve(meta.count() + events.count() + 2*count);
+        std::uint32_t tick = 0;
+        for (std::size_t i = 0; i < meta.count(); i++)
+          {
+            tick += meta.dt(i);
+            Item it = {tick, order[i], META, std::uint32_t(i)};
+            item.push_back(it);
+          }
+        tick = 0;
+        for (std::size_t i = 0; i < events.count(); i++)
+          {
+            tick += events.dt(i);
+            Item it = {tick, order[meta.count() + i], EVENT, std::uint32_t(i)};
+            item.push_back(it);
+          }
+        for (std::size_t i = 0; i < count; i++)
+          {
+            Item on = {b[i], onOrd[i], ON, std::uint32_t(i)};
+            Item off = {b[i] + d[i], offOrd[i], OFF, std::uint32_t(i)};
+            item.push_back(on);
+            item.push_back(off);
+          }
+        std::stable_sort(item.begin(), item.end(), [](const Item & x, const Item & y)
+                         {return x.tick < y.tick || (x.tick == y.tick && x.order < y.order);});
+
+        const std::uint8_t* p = pitch(t);
+        const std::uint8_t* v = velocity(t);
+        const std::uint8_t* r = release(t);
+        const std::uint8_t* c = channel(t);
+        CompactTrack* out = new CompactTrack;
+        tracks.push_back(std::unique_ptr<Track>(out));
+        out->reserve(item.size());
+        std::uint32_t lastTick = 0;
+        for (std::size_t i = 0; i < item.size(); i++)
+          {
+            std::uint32_t dt = item[i].tick - lastTick;
+            std::uint32_t n = item[i].index;
+            lastTick = item[i].tick;
+            if (item[i].kind == META)
+              {
+                const CompactEvent & ev = meta.event()[n];
+                out->addMeta(dt, ev.param1, meta.payload(n), ev.length);
+              }
+            else if (item[i].kind == EVENT)
+              {
+                const CompactEvent & ev = events.event()[n];
+                if (ev.status >= 0xF0) out->addSysEx(dt, ev.status, events.payload(n), ev.length);
+                else out->addChannel(dt, ev.status, ev.param1, ev.param2);
+              }
+            else if (item[i].kind == ON)
+              out->addChannel(dt, 0x90 | (c[n] & 0x0F), p[n] & 0x7F, v[n] & 0x7F);
+            else if (r[n] == 0xFF) out->addChannel(dt, 0x90 | (c[n] & 0x0F), p[n] & 0x7F, 0);
+            else out->addChannel(dt, 0x80 | (c[n] & 0x0F), p[n] & 0x7F, r[n] & 0x7F);
+          }
+      }
+
+    if (type() == 0)
+      {
+        if (tracks.size() != 1) return NULL;
+        return new MIDI_Type0(std::move(tracks[0]), timeDivision());
+      }
+    if (type() == 1) return new MIDI_Type1(std::move(tracks), timeDivision());
+    return new MIDI_Type2(std::move(tracks), timeDivision());
+  }
+
+} //Namespace
@@ -0,0 +1,129 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----NoteCache Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the NoteCache class, a columnar file format for the
+  notes of a MIDI which can be memory mapped and used without parsing.
+*/
+
+#ifndef _notecache_hpp_
+#define _notecache_hpp_
+
+#include "midi.hpp"
+#include "compacttrack.hpp"
+#include "sink.hpp"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+namespace midi
+{
+
+  //The file holds a header, a table with an entry per track, then each
+  //track's sections, every one aligned to 64 bytes. Each note column is a
+  //plain array in the machine's byte order. Everything that isn't a paired
+  //Note On and Note Off goes in two small MTrk chunks: one for meta events
+  //and one for the rest. Between them, the sections hold every event of the
+  //original tracks. The position of every event among the others at its tick
+  //is kept too, in two more columns for the notes and a last section of
+  //uint32_t for the meta events then the rest, so converting back restores
+  //the original order exactly.
+  class NoteCache
+  {
+  public:
+    enum Column
+    {
+      BEGIN,       //uint32_t, tick the note starts
+      DURATION,    //uint32_t, in ticks
+      PITCH,       //uint8_t
+      VELOCITY,    //uint8_t
+      RELEASE,     //uint8_t, Note Off velocity, or 0xFF for a Note On with
+                   //velocity 0
+      CHANNEL,     //uint8_t
+      INSTRUMENT,  //uint8_t, program of the channel when the note starts
+      ON_ORDER,    //uint32_t, position of the Note On within its tick
+      OFF_ORDER,   //uint32_t, position of the Note Off within its tick
+      COLUMNS
+    };
+
+    //Column widths in bytes
+    static std::size_t width(Column col) {return (col <= DURATION || col >= ON_ORDER) ? 4 : 1;}
+
+    //Encoding. Notes are ordered by when they start.
+    static std::vector<std::uint8_t> encode(const MIDI & mid);
+    static bool write(const MIDI & mid, ByteSink & sink);
+    static bool write(const MIDI & mid, const std::string & filename);
+
+    //Maps a cache file, or uses one already in memory, which must stay there
+    //and be aligned to 8 bytes. Check valid() afterwards.
+    NoteCache(const std::string & filename);
+    NoteCache(const std::uint8_t* data, std::size_t size);
+
+    //File information
+    bool valid() const {return valid_;}
+    std::uint16_t type() const;
+    TimeDivision timeDivision() const;
+    std::size_t numTracks() const;
+
+    //Columns of a track, straight from the file
+    std::size_t notes(std::size_t track) const;
+    const void* column(std::size_t track, Column col) const;
+    const std::uint32_t* begin(std::size_t track) const
+    {return static_cast<const std::uint32_t*>(column(track, BEGIN));}
+    const std::uint32_t* duration(std::size_t track) const
+    {return static_cast<const std::uint32_t*>(column(track, DURATION));}
+    const std::uint8_t* pitch(std::size_t track) const
+    {return static_cast<const std::uint8_t*>(column(track, PITCH));}
+    const std::uint8_t* velocity(std::size_t track) const
+    {return static_cast<const std::uint8_t*>(column(track, VELOCITY));}
+    const std::uint8_t* release(std::size_t track) const
+    {return static_cast<const std::uint8_t*>(column(track, RELEASE));}
+    const std::uint8_t* channel(std::size_t track) const
+    {return static_cast<const std::uint8_t*>(column(track, CHANNEL));}
+    const std::uint8_t* instrument(std::size_t track) const
+    {return static_cast<const std::uint8_t*>(column(track, INSTRUMENT));}
+    const std::uint32_t* onOrder(std::size_t track) const
+    {return static_cast<const std::uint32_t*>(column(track, ON_ORDER));}
+    const std::uint32_t* offOrder(std::size_t track) const
+    {return static_cast<const std::uint32_t*>(column(track, OFF_ORDER));}
+
+    //The other sections of a track, decoded
+    //Empty if the section is malformed
+    CompactTrack meta(std::size_t track) const;
+    CompactTrack events(std::size_t track) const;
+
+    //Conversions
+    NoteTrack toNotes(std::size_t track) const;
+
+    //Rebuilds the whole MIDI with a CompactTrack per track
+    //Returns NULL if the cache is invalid or a section is malformed
+    //THIS MUST BE MANUALLY FREED BY THE USER WITH freeLoadedMIDI
+    MIDI* toMIDI() const;
+
+  private:
+    //Caches can't be copied, only shared
+    NoteCache(const NoteCache&);
+    NoteCache& operator=(const NoteCache&);
+
+    //Checks every section lies within the file
+    bool check() const;
+
+    //Decodes an MTrk chunk section
+    //Returns false, leaving out empty, if it is malformed
+    bool section(std::size_t track, bool meta, CompactTrack & out) const;
+
+    std::shared_ptr<MappedFile> file_;
+    const std::uint8_t* data_;
+    std::size_t size_;
+    bool valid_;
+  };
+
+} //Namespace
+
+#endif
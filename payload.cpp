@@ -0,0 +1,109 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Payload Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the Payload class, the variable-length data
+  carried by meta and SysEx events.
+*/
+
+#include "payload.hpp"
+
+#include <utility>
+
+namespace midi
+{
+
+  //Default constructor, empty and owning
+  Payload::Payload() : view_(NULL), viewSize_(0) {}
+
+  //Copies a range of bytes into owned storage
+  Payload::Payload(const std::uint8_t* first, const std::uint8_t* last) :
+    own_(first, last), view_(NULL), viewSize_(0) {}
+
+  //Copy constructor, always takes its own copy of the bytes
+  Payload::Payload(const Payload& p) :
+    own_(p.begin(), p.end()), view_(NULL), viewSize_(0) {}
+
+  //Move constructor, a view stays a view
+  Payload::Payload(Payload&& p) :
+    own_(std::move(p.own_)), view_(p.view_), viewSize_(p.viewSize_)
+  {
+    p.own_.clear();
+    p.view_ = NULL;
+    p.viewSize_ = 0;
+  }
+
+  //Creates a non-owning payload. The memory must outlive it.
+  Payload Payload::view(const std::uint8_t* data, std::size_t size)
+  {
+    Payload p;
+    p.view_ = data;
+    p.viewSize_ = size;
+    return p;
+  }
+
+  //Copy assignment
+  Payload& Payload::operator=(const Payload& p)
+  {
+    if (this == &p) return *this;
+    std::vector<std::uint8_t> bytes(p.begin(), p.end());
+    own_.swap(bytes);
+    view_ = NULL;
+    viewSize_ = 0;
+    return *this;
+  }
+
+  //Move assignment
+  Payload& Payload::operator=(Payload&& p)
+  {
+    if (this == &p) return *this;
+    own_ = std::move(p.own_);
+    view_ = p.view_;
+    viewSize_ = p.viewSize_;
+    p.own_.clear();
+    p.view_ = NULL;
+    p.viewSize_ = 0;
+    return *this;
+  }
+
+  //Number of bytes
+  std::size_t Payload::size() const
+  {
+    if (view_ != NULL) return viewSize_;
+    return own_.size();
+  }
+
+  //Pointer to the first byte
+  const std::uint8_t* Payload::begin() const
+  {
+    if (view_ != NULL) return view_;
+    return own_.data();
+  }
+
+  //Typecast to a vector, copying the bytes
+  Payload::operator std::vector<std::uint8_t>() const
+  {
+    return std::vector<std::uint8_t>(begin(), end());
+  }
+
+  //Adds a byte to the end
+  void Payload::push_back(std::uint8_t byte)
+  {
+    own();
+    own_.push_back(byte);
+  }
+
+  //Copies viewed bytes into owned storage
+  void Payload::own()
+  {
+    if (view_ == NULL) return;
+    own_.assign(view_, view_ + viewSize_);
+    view_ = NULL;
+    viewSize_ = 0;
+  }
+
+} //Namespace
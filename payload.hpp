@@ -0,0 +1,72 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Payload Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the Payload class, the variable-length data carried by
+  meta and SysEx events. A payload either owns its bytes or is a view into memory
+  owned by someone else, such as a memory-mapped file.
+*/
+
+#ifndef _payload_hpp_
+#define _payload_hpp_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace midi
+{
+
+  class Payload
+  {
+  public:
+    //Constructors
+    //Copies always produce an owning payload; moves keep views as views
+    Payload();
+    Payload(const std::uint8_t* first, const std::uint8_t* last);
+    Payload(const Payload& p);
+    Payload(Payload&& p);
+
+    //Creates a payload referring to memory it does not own
+    static Payload view(const std::uint8_t* data, std::size_t size);
+
+    //Assignment
+    Payload& operator=(const Payload& p);
+    Payload& operator=(Payload&& p);
+
+    //Access
+    std::size_t size() const;
+    bool empty() const {return size() == 0;}
+    std::uint8_t operator[](std::size_t index) const {return begin()[index];}
+    const std::uint8_t* begin() const;
+    const std::uint8_t* end() const {return begin() + size();}
+    bool isView() const {return view_ != NULL;}
+    operator std::vector<std::uint8_t>() const;
+
+    //Modification, which turns a view into an owning payload first
+    void push_back(std::uint8_t byte);
+    template <class InputIt> void append(InputIt first, InputIt last);
+
+  private:
+    //Copies viewed bytes into owned storage
+    void own();
+
+    std::vector<std::uint8_t> own_;
+    const std::uint8_t* view_;
+    std::size_t viewSize_;
+  };
+
+  //Appends a range of bytes
+  template <class InputIt> void Payload::append(InputIt first, InputIt last)
+  {
+    own();
+    own_.insert(own_.end(), first, last);
+  }
+
+} //Namespace
+
+#endif
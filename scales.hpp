@@ -7,6 +7,7 @@
   austonst@gmail.com
 
   Contains constants and functions to be able to easily use or reference scales.
+  Everything here can be evaluated at compile time.
 */
 
 #ifndef _scales_hpp_
@@ -16,12 +17,43 @@
 
 namespace midi
 {
+
+  //The semitones above the key of each of the seven degrees of a scale
+  struct Scale
+  {
+    std::int8_t degree[7];
+  };
+
+  constexpr Scale MAJOR_SCALE = {{0, 2, 4, 5, 7, 9, 11}};
+  constexpr Scale NAT_MINOR_SCALE = {{0, 2, 3, 5, 7, 8, 10}};
+  constexpr Scale HAR_MINOR_SCALE = {{0, 2, 3, 5, 7, 8, 11}};
+
+  //Church modes
+  constexpr Scale IONIAN_MODE = MAJOR_SCALE;
+  constexpr Scale DORIAN_MODE = {{0, 2, 3, 5, 7, 9, 10}};
+  constexpr Scale PHRYGIAN_MODE = {{0, 1, 3, 5, 7, 8, 10}};
+  constexpr Scale LYDIAN_MODE = {{0, 2, 4, 6, 7, 9, 11}};
+  constexpr Scale MIXOLYDIAN_MODE = {{0, 2, 4, 5, 7, 9, 10}};
+  constexpr Scale AEOLIAN_MODE = NAT_MINOR_SCALE;
+  constexpr Scale LOCRIAN_MODE = {{0, 1, 3, 5, 6, 8, 10}};
+
+  //Returns the note given as a number in the scale based at the input key.
+  //1 is the key itself, 8 the key an octave up, and 0 the degree below the key.
+  constexpr Note scaleNote(const Scale & scale, Note key, int num)
+  {
+    return (num >= 1) ?
+      Note(key.midiVal() + 12*((num-1)/7) + scale.degree[(num-1)%7]) :
+      Note(key.midiVal() - 12*((7-num)/7) + scale.degree[num-1 + 7*((7-num)/7)]);
+  }
   
-  Note majorScale(Note key, char num);
+  //Returns the note given as a number in the major scale based at the input key
+  constexpr Note majorScale(Note key, char num) {return scaleNote(MAJOR_SCALE, key, num);}
   
-  Note natMinorScale(Note key, char num);
+  //Returns the note given as a number in the natural minor scale based at the input key
+  constexpr Note natMinorScale(Note key, char num) {return scaleNote(NAT_MINOR_SCALE, key, num);}
 
-  Note harMinorScale(Note key, char num);
+  //Returns the note given as a number in the harmonic minor scale based at the key
+  constexpr Note harMinorScale(Note key, char num) {return scaleNote(HAR_MINOR_SCALE, key, num);}
   
 } //Namespace
 
@@ -0,0 +1,367 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Sequencer Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the Sequencer class, which plays a MIDI in
+  real time from a dedicated thread.
+*/
+
+#include "sequencer.hpp"
+#include "compacttrack.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace midi
+{
+
+  //Sleeping stops this long before a message is due, then the thread spins
+  //the rest of the way. Sleeps wake up late by more than we can allow.
+  static const std::chrono::microseconds SPIN_TIME(1000);
+
+  //Longest the thread goes without looking for commands
+  static const std::chrono::microseconds POLL_TIME(2000);
+
+  //Number of parameter bytes following a channel status byte
+  static std::size_t channelParams(std::uint8_t status)
+  {
+    return (status >> 4 == 0x0C || status >> 4 == 0x0D) ? 1 : 2;
+  }
+
+  //Index of the lowest set bit of a nonzero number
+  static int lowestBit(std::uint64_t bits)
+  {
+#ifdef __GNUC__
+    return __builtin_ctzll(bits);
+#else
+    int ret = 0;
+    while (!(bits & 1))
+      {
+        bits >>= 1;
+        ret++;
+      }
+    return ret;
+#endif
+  }
+
+  static bool earlierChange(const std::pair<std::uint32_t, std::uint32_t> & a,
+                            const std::pair<std::uint32_t, std::uint32_t> & b)
+  {
+    return a.first < b.first;
+  }
+
+  //Messages are ordered by tick alone, so sorting keeps the track order
+  //within a tick
+  bool Sequencer::earlierTick(const Message & a, const Message & b)
+  {
+    return a.tick < b.tick;
+  }
+
+  bool Sequencer::earlierTime(const Message & a, const Message & b)
+  {
+    return a.time < b.time;
+  }
+
+  //Constructor, schedules everything then starts the playback thread paused
+  Sequencer::Sequencer(const MIDI & mid, ByteSink & sink) :
+    tempo_(mid.timeDivision()), sink_(sink), next_(0), anchor_(0),
+    anchorWall_(Clock::now()), scale_(1.0), playing_(false), finished_(false),
+    position_(0), sent_(0)
+  {
+    std::memset(sounding_, 0, sizeof(sounding_));
+    schedule(mid);
+    finished_ = message_.empty();
+    thread_ = std::thread(&Sequencer::run, this);
+  }
+
+  //Destructor, silences the output and stops the thread
+  Sequencer::~Sequencer()
+  {
+    while (!command(Command::QUIT)) std::this_thread::yield();
+    thread_.join();
+  }
+
+  //Merges the tracks into one list of messages in wire format
+  void Sequencer::schedule(const MIDI & mid)
+  {
+    std::size_t tracks = mid.numTracks();
+    if (mid.type() == 2 && tracks > 1) tracks = 1;
+
+    std::vector<std::pair<std::uint32_t, std::uint32_t> > changes;
+    for (std::size_t t = 0; t < tracks; t++)
+      {
+        CompactTrack ct(mid.track(t));
+
+        std::uint32_t tick = 0;
+        for (std::size_t i = 0; i < ct.count(); i++)
+          {
+            const CompactEvent & ev = ct.event()[i];
+            tick += ev.deltaTime;
+
+            //Meta events aren't sent, but tempo changes decide the timing
+            if (ev.status == 0xFF)
+              {
+                if (ev.param1 == 0x51 && ev.length == 3)
+                  {
+                    const std::uint8_t* p = ct.payload(i);
+                    changes.push_back(std::make_pair(tick, (std::uint32_t(p[0]) << 16) |
+                                                     (std::uint32_t(p[1]) << 8) | p[2]));
+                  }
+                continue;
+              }
+
+            Message msg;
+            msg.time = 0;
+            msg.tick = tick;
+            msg.offset = bytes_.size();
+            if (ev.status >= 0xF0)
+              {
+                //SysEx packets lose their length; escapes are sent as they are
+                if (ev.status == 0xF0) bytes_.push_back(0xF0);
+                bytes_.insert(bytes_.end(), ct.payload(i), ct.payload(i) + ev.length);
+              }
+            else
+              {
+                bytes_.push_back(ev.status);
+                bytes_.push_back(ev.param1);
+                if (channelParams(ev.status) == 2) bytes_.push_back(ev.param2);
+              }
+            msg.length = bytes_.size() - msg.offset;
+            if (msg.length > 0) message_.push_back(msg);
+          }
+      }
+
+    //Tempo changes may be in any track, so they're put in order first
+    std::stable_sort(changes.begin(), changes.end(), earlierChange);
+    for (std::size_t i = 0; i < changes.size(); i++)
+      {
+        tempo_.setTempo(changes[i].first, changes[i].second);
+      }
+
+    //Then every message gets its time in one pass
+    std::stable_sort(message_.begin(), message_.end(), earlierTick);
+    std::vector<std::uint32_t> ticks(message_.size());
+    std::vector<std::uint64_t> times(message_.size());
+    for (std::size_t i = 0; i < message_.size(); i++)
+      {
+        ticks[i] = message_[i].tick;
+      }
+    if (!ticks.empty()) tempo_.microseconds(&ticks[0], ticks.size(), &times[0]);
+    for (std::size_t i = 0; i < message_.size(); i++)
+      {
+        message_[i].time = times[i];
+      }
+  }
+
+  //Controls, each sent to the playback thread as a command
+  bool Sequencer::play()
+  {
+    return command(Command::PLAY);
+  }
+
+  bool Sequencer::pause()
+  {
+    return command(Command::PAUSE);
+  }
+
+  bool Sequencer::seek(std::uint32_t tick)
+  {
+    return command(Command::SEEK, tick);
+  }
+
+  bool Sequencer::seekTime(std::uint64_t microseconds)
+  {
+    return command(Command::SEEK_TIME, microseconds);
+  }
+
+  //Scales of 2 play twice as fast, 0.5 half as fast
+  bool Sequencer::setTempoScale(double scale)
+  {
+    if (!(scale > 0)) return false;
+    return command(Command::TEMPO_SCALE, 0, scale);
+  }
+
+  bool Sequencer::command(Command::Type type, std::uint64_t value, double scale)
+  {
+    Command cmd;
+    cmd.type = type;
+    cmd.value = value;
+    cmd.scale = scale;
+    return command_.push(cmd);
+  }
+
+  //Song time reached at a wall clock time
+  std::uint64_t Sequencer::songTime(Clock::time_point now) const
+  {
+    if (now <= anchorWall_) return anchor_;
+    std::chrono::nanoseconds elapsed = now - anchorWall_;
+    return anchor_ + std::uint64_t(elapsed.count() * scale_ / 1000);
+  }
+
+  //Wall clock time at which the song reaches a time
+  Sequencer::Clock::time_point Sequencer::wallTime(std::uint64_t time) const
+  {
+    if (time <= anchor_) return anchorWall_;
+    double ns = (time - anchor_) * 1000 / scale_;
+    return anchorWall_ + std::chrono::duration_cast<Clock::duration>
+      (std::chrono::duration<double, std::nano>(ns));
+  }
+
+  //The playback loop. Nothing here allocates.
+  void Sequencer::run()
+  {
+    Command cmd;
+    for (;;)
+      {
+        while (command_.pop(cmd))
+          {
+            if (!apply(cmd)) return;
+          }
+
+        Clock::time_point now = Clock::now();
+        if (!playing_.load(std::memory_order_relaxed))
+          {
+            std::this_thread::sleep_for(POLL_TIME);
+            continue;
+          }
+
+        //Send everything that's due, all at once
+        std::uint64_t pos = songTime(now);
+        std::size_t first = next_;
+        while (next_ < message_.size() && message_[next_].time <= pos)
+          {
+            send(message_[next_++]);
+          }
+        if (next_ != first) sink_.flush();
+        position_.store(pos, std::memory_order_release);
+
+        if (next_ == message_.size())
+          {
+            position_.store(length(), std::memory_order_release);
+            playing_.store(false, std::memory_order_release);
+            finished_.store(true, std::memory_order_release);
+            continue;
+          }
+
+        //Sleep most of the way to the next message, then spin
+        Clock::time_point due = wallTime(message_[next_].time);
+        now = Clock::now();
+        if (due - now > SPIN_TIME)
+          {
+            Clock::duration wait = due - now - SPIN_TIME;
+            if (wait > POLL_TIME) wait = POLL_TIME;
+            std::this_thread::sleep_for(wait);
+          }
+        else
+          {
+            while (Clock::now() < due) {}
+          }
+      }
+  }
+
+  //Carries out a command, returning false when the thread should exit
+  bool Sequencer::apply(const Command & cmd)
+  {
+    Clock::time_point now = Clock::now();
+    bool playing = playing_.load(std::memory_order_relaxed);
+    switch (cmd.type)
+      {
+      case Command::PLAY:
+        if (playing || next_ == message_.size()) break;
+        anchorWall_ = now;
+        playing_.store(true, std::memory_order_release);
+        break;
+
+      case Command::PAUSE:
+        if (!playing) break;
+        anchor_ = songTime(now);
+        anchorWall_ = now;
+        position_.store(anchor_, std::memory_order_release);
+        playing_.store(false, std::memory_order_release);
+        silence();
+        break;
+
+      case Command::SEEK:
+        moveTo(tempo_.microseconds(std::uint32_t(cmd.value)));
+        break;
+
+      case Command::SEEK_TIME:
+        moveTo(cmd.value);
+        break;
+
+      case Command::TEMPO_SCALE:
+        if (playing) anchor_ = songTime(now);
+        anchorWall_ = now;
+        scale_ = cmd.scale;
+        break;
+
+      case Command::QUIT:
+        silence();
+        return false;
+      }
+
+    return true;
+  }
+
+  //Jumps to a song time. Messages at exactly that time are sent.
+  void Sequencer::moveTo(std::uint64_t time)
+  {
+    silence();
+    Message key;
+    key.time = time;
+    next_ = std::lower_bound(message_.begin(), message_.end(), key,
+                             earlierTime) - message_.begin();
+    anchor_ = time;
+    anchorWall_ = Clock::now();
+    position_.store(time, std::memory_order_release);
+
+    //Seeking past the end stops playback
+    bool done = (next_ == message_.size());
+    if (done) playing_.store(false, std::memory_order_release);
+    finished_.store(done, std::memory_order_release);
+  }
+
+  //Writes one message, keeping track of which notes are sounding
+  void Sequencer::send(const Message & msg)
+  {
+    const std::uint8_t* bytes = &bytes_[msg.offset];
+    sink_.write(bytes, msg.length);
+    sent_.fetch_add(1, std::memory_order_release);
+
+    std::uint8_t kind = bytes[0] >> 4;
+    if ((kind != 0x08 && kind != 0x09) || msg.length != 3) return;
+    std::uint8_t channel = bytes[0] & 0x0F;
+    std::uint64_t bit = std::uint64_t(1) << (bytes[1] & 0x3F);
+    std::uint64_t & word = sounding_[channel][bytes[1] >> 6];
+    if (kind == 0x09 && bytes[2] > 0) word |= bit;
+    else word &= ~bit;
+  }
+
+  //Sends a Note Off for every note left sounding
+  void Sequencer::silence()
+  {
+    bool any = false;
+    for (std::uint8_t channel = 0; channel < 16; channel++)
+      {
+        for (std::uint8_t half = 0; half < 2; half++)
+          {
+            std::uint64_t word = sounding_[channel][half];
+            while (word != 0)
+              {
+                std::uint8_t key = (half << 6) | lowestBit(word);
+                std::uint8_t off[3] = {std::uint8_t(0x80 | channel), key, 0};
+                sink_.write(off, 3);
+                word &= word - 1;
+                any = true;
+              }
+            sounding_[channel][half] = 0;
+          }
+      }
+    if (any) sink_.flush();
+  }
+
+} //Namespace
@@ -0,0 +1,125 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Sequencer Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the Sequencer class, which plays a MIDI in real time
+  by writing its messages to a ByteSink from a dedicated thread.
+*/
+
+#ifndef _sequencer_hpp_
+#define _sequencer_hpp_
+
+#include "midi.hpp"
+#include "sink.hpp"
+#include "tempomap.hpp"
+#include "boundedqueue.hpp"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace midi
+{
+
+  //Everything is worked out before the playback thread starts: the events of
+  //every track are merged, converted to microseconds and stored as raw wire
+  //bytes. Once playing, the thread only reads those tables, so it never
+  //allocates. Other threads control it through a lock-free queue.
+  class Sequencer
+  {
+  public:
+    //The sink is written from the playback thread and must outlive the
+    //sequencer. Only the first track of a type 2 MIDI is played.
+    Sequencer(const MIDI & mid, ByteSink & sink);
+    ~Sequencer();
+
+    //Controls, safe to call from any thread
+    //Each returns false if too many commands are already waiting
+    bool play();
+    bool pause();
+    bool seek(std::uint32_t tick);
+    bool seekTime(std::uint64_t microseconds);
+    bool setTempoScale(double scale);
+
+    //State as last published by the playback thread
+    bool playing() const {return playing_.load(std::memory_order_acquire);}
+    bool finished() const {return finished_.load(std::memory_order_acquire);}
+    std::uint64_t position() const {return position_.load(std::memory_order_acquire);}
+    std::size_t sent() const {return sent_.load(std::memory_order_acquire);}
+
+    //Length of the song in microseconds at normal speed
+    std::uint64_t length() const {return message_.empty() ? 0 : message_.back().time;}
+    std::size_t count() const {return message_.size();}
+
+  private:
+    //Sequencers own a thread and can't be copied
+    Sequencer(const Sequencer&);
+    Sequencer& operator=(const Sequencer&);
+
+    //One message ready to be sent, as a range of bytes_
+    struct Message
+    {
+      std::uint64_t time;
+      std::uint32_t tick;
+      std::uint32_t offset;
+      std::uint32_t length;
+    };
+    static bool earlierTick(const Message & a, const Message & b);
+    static bool earlierTime(const Message & a, const Message & b);
+
+    struct Command
+    {
+      enum Type {PLAY, PAUSE, SEEK, SEEK_TIME, TEMPO_SCALE, QUIT};
+      Type type;
+      std::uint64_t value;
+      double scale;
+    };
+
+    //Builds message_ and bytes_ from the tracks of a MIDI
+    void schedule(const MIDI & mid);
+
+    typedef std::chrono::steady_clock Clock;
+
+    //Playback thread functions
+    void run();
+    std::uint64_t songTime(Clock::time_point now) const;
+    Clock::time_point wallTime(std::uint64_t time) const;
+    bool apply(const Command & cmd);
+    void moveTo(std::uint64_t time);
+    void send(const Message & msg);
+    void silence();
+
+    bool command(Command::Type type, std::uint64_t value = 0, double scale = 1.0);
+
+    std::vector<Message> message_;
+    std::vector<std::uint8_t> bytes_;
+    TempoMap tempo_;
+    ByteSink & sink_;
+
+    BoundedQueue<Command, 64> command_;
+
+    //Playback thread state. The song was at anchor_ microseconds at the wall
+    //clock time anchorWall_, and moves scale_ times as fast as the clock.
+    std::size_t next_;
+    std::uint64_t anchor_;
+    Clock::time_point anchorWall_;
+    double scale_;
+    std::uint64_t sounding_[16][2];
+
+    std::atomic<bool> playing_;
+    std::atomic<bool> finished_;
+    std::atomic<std::uint64_t> position_;
+    std::atomic<std::size_t> sent_;
+
+    std::thread thread_;
+  };
+
+} //Namespace
+
+#endif
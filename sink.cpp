@@ -0,0 +1,97 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----ByteSink Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the ByteSink class and its implementations,
+  destinations that encoded MIDI data can be streamed into.
+*/
+
+#include "sink.hpp"
+
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace midi
+{
+
+  //StreamSink functions
+  bool StreamSink::write(const std::uint8_t* data, std::size_t size)
+  {
+    out_.write((const char*)(data), size);
+    return bool(out_);
+  }
+
+  bool StreamSink::flush()
+  {
+    out_.flush();
+    return bool(out_);
+  }
+
+  //Writes everything, retrying after interruptions and partial writes
+  static bool writeAll(int fd, const std::uint8_t* data, std::size_t size)
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    while (size > 0)
+      {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0)
+          {
+            if (errno == EINTR) continue;
+            return false;
+          }
+        data += written;
+        size -= written;
+      }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  //FileDescriptorSink functions
+  bool FileDescriptorSink::write(const std::uint8_t* data, std::size_t size)
+  {
+    //Small writes are collected
+    if (used_ + size <= CAPACITY)
+      {
+        std::memcpy(buffer_ + used_, data, size);
+        used_ += size;
+        return true;
+      }
+
+    //Large ones go straight through after what we have
+    if (!flush()) return false;
+    if (size < CAPACITY)
+      {
+        std::memcpy(buffer_, data, size);
+        used_ = size;
+        return true;
+      }
+    return writeAll(fd_, data, size);
+  }
+
+  bool FileDescriptorSink::flush()
+  {
+    bool ret = writeAll(fd_, buffer_, used_);
+    used_ = 0;
+    return ret;
+  }
+
+  //BufferSink functions
+  bool BufferSink::write(const std::uint8_t* data, std::size_t size)
+  {
+    if (capacity_ - used_ < size) return false;
+    std::memcpy(buffer_ + used_, data, size);
+    used_ += size;
+    return true;
+  }
+
+} //Namespace
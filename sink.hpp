@@ -0,0 +1,80 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----ByteSink Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the ByteSink class and its implementations,
+  destinations that encoded MIDI data can be streamed into.
+*/
+
+#ifndef _sink_hpp_
+#define _sink_hpp_
+
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+namespace midi
+{
+
+  //Anything bytes can be written to
+  class ByteSink
+  {
+  public:
+    virtual ~ByteSink() {};
+
+    //Both return false if the bytes could not be written
+    virtual bool write(const std::uint8_t* data, std::size_t size) = 0;
+    virtual bool flush() {return true;}
+  };
+
+  //Writes to a standard output stream
+  class StreamSink : public ByteSink
+  {
+  public:
+    StreamSink(std::ostream & out) : out_(out) {}
+    bool write(const std::uint8_t* data, std::size_t size);
+    bool flush();
+
+  private:
+    std::ostream & out_;
+  };
+
+  //Writes to a file descriptor, collecting small writes into one system call
+  class FileDescriptorSink : public ByteSink
+  {
+  public:
+    FileDescriptorSink(int fd) : fd_(fd), used_(0) {}
+    ~FileDescriptorSink() {flush();}
+    bool write(const std::uint8_t* data, std::size_t size);
+    bool flush();
+
+  private:
+    static const std::size_t CAPACITY = 65536;
+
+    int fd_;
+    std::size_t used_;
+    std::uint8_t buffer_[CAPACITY];
+  };
+
+  //Writes into a fixed caller-supplied buffer, failing once it is full
+  class BufferSink : public ByteSink
+  {
+  public:
+    BufferSink(std::uint8_t* buffer, std::size_t capacity) :
+      buffer_(buffer), capacity_(capacity), used_(0) {}
+    bool write(const std::uint8_t* data, std::size_t size);
+    std::size_t used() const {return used_;}
+
+  private:
+    std::uint8_t* buffer_;
+    std::size_t capacity_;
+    std::size_t used_;
+  };
+
+} //Namespace
+
+#endif
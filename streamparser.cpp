@@ -0,0 +1,279 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----StreamParser Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the StreamParser class, which decodes Standard
+  MIDI File bytes incrementally as they arrive in arbitrary pieces.
+*/
+
+#include "streamparser.hpp"
+
+#include <algorithm>
+
+namespace midi
+{
+
+  //Finds the length of the event at the start of p without decoding it.
+  //Returns 1 and the exact length if it is complete, 0 and a lower bound on
+  //the length if more bytes are needed, or -1 if it can never be valid.
+  static int measureEvent(const std::uint8_t* p, std::size_t avail,
+                          std::uint8_t runningStatus, std::size_t & length)
+  {
+    std::size_t i = 0;
+
+    //Delta time
+    for (int k = 0; ; k++)
+      {
+        if (k == VARLENGTH_MAX_SIZE) return -1;
+        if (i == avail)
+          {
+            length = i + 1;
+            return 0;
+          }
+        if (!(p[i++] & 0x80)) break;
+      }
+    if (i == avail)
+      {
+        length = i + 1;
+        return 0;
+      }
+
+    //Channel events have a fixed size
+    std::uint8_t status = p[i];
+    if (status != 0xFF && status != 0xF0 && status != 0xF7)
+      {
+        if (status & 0x80)
+          {
+            if (status > 0xF0) return -1;
+            i++;
+          }
+        else
+          {
+            if (runningStatus == 0) return -1;
+            status = runningStatus;
+          }
+        length = i + ((status >> 4 == 0x0C || status >> 4 == 0x0D) ? 1 : 2);
+        return (length <= avail) ? 1 : 0;
+      }
+
+    //Meta and SysEx events say how long they are
+    i += (status == 0xFF) ? 2 : 1;
+    std::uint32_t size = 0;
+    for (int k = 0; ; k++)
+      {
+        if (k == VARLENGTH_MAX_SIZE) return -1;
+        if (i >= avail)
+          {
+            length = i + 1;
+            return 0;
+          }
+        size = (size << 7) | (p[i] & 0x7F);
+        if (!(p[i++] & 0x80)) break;
+      }
+    length = i + size;
+    return (length <= avail) ? 1 : 0;
+  }
+
+  //Reads a big-endian 32 bit number
+  static std::uint32_t readUint32(const std::uint8_t* p)
+  {
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+      (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+  }
+
+  //Constructor
+  StreamParser::StreamParser(EventCallback callback) : callback_(callback)
+  {
+    reset();
+  }
+
+  //Forget all state
+  void StreamParser::reset()
+  {
+    state_ = CHUNK_HEADER;
+    failed_ = false;
+    remaining_ = 0;
+    pending_.clear();
+    type_ = 0;
+    numTracks_ = 0;
+    td_ = TimeDivision();
+    files_ = 0;
+    track_ = 0;
+    runningStatus_ = 0;
+  }
+
+  //Parses the next piece of input
+  bool StreamParser::feed(const std::uint8_t* data, std::size_t size)
+  {
+    if (failed_) return false;
+
+    const std::uint8_t* pos = data;
+    const std::uint8_t* end = data + size;
+    const std::uint8_t* item;
+    while (pos != end && !failed_)
+      {
+        switch (state_)
+          {
+          case CHUNK_HEADER:
+            if (!gather(pos, end, 8, item)) return true;
+            chunkHeader(item);
+            break;
+          case FILE_HEADER:
+            if (!gather(pos, end, 6, item)) return true;
+            fileHeader(item);
+            break;
+          case TRACK:
+            if (!trackEvents(pos, end)) return !failed_;
+            break;
+          case SKIP:
+            {
+              std::size_t skip = std::min<std::size_t>(remaining_, end - pos);
+              pos += skip;
+              remaining_ -= skip;
+              if (remaining_ == 0) state_ = CHUNK_HEADER;
+            }
+            break;
+          }
+      }
+
+    //A track can end exactly at the end of the input
+    if (state_ == TRACK && remaining_ == 0) state_ = CHUNK_HEADER;
+    return !failed_;
+  }
+
+  //Gathers exactly need bytes, copying only when they are split across inputs
+  bool StreamParser::gather(const std::uint8_t* & pos, const std::uint8_t* end,
+                            std::size_t need, const std::uint8_t* & item)
+  {
+    if (pending_.empty() && std::size_t(end - pos) >= need)
+      {
+        item = pos;
+        pos += need;
+        return true;
+      }
+
+    std::size_t take = std::min<std::size_t>(need - pending_.size(), end - pos);
+    pending_.insert(pending_.end(), pos, pos + take);
+    pos += take;
+    if (pending_.size() < need) return false;
+    item = pending_.data();
+    return true;
+  }
+
+  //Handles a complete chunk header
+  void StreamParser::chunkHeader(const std::uint8_t* item)
+  {
+    std::uint32_t length = readUint32(item + 4);
+    bool isFile = (item[0] == 'M' && item[1] == 'T' && item[2] == 'h' && item[3] == 'd');
+    bool isTrack = (item[0] == 'M' && item[1] == 'T' && item[2] == 'r' && item[3] == 'k');
+    pending_.clear();
+
+    if (isFile)
+      {
+        if (length < 6)
+          {
+            failed_ = true;
+            return;
+          }
+        remaining_ = length - 6;
+        state_ = FILE_HEADER;
+      }
+    else if (isTrack)
+      {
+        remaining_ = length;
+        runningStatus_ = 0;
+        track_++;
+        state_ = (length == 0) ? CHUNK_HEADER : TRACK;
+      }
+    else
+      {
+        remaining_ = length;
+        state_ = (length == 0) ? CHUNK_HEADER : SKIP;
+      }
+  }
+
+  //Handles a complete file header, starting a new file
+  void StreamParser::fileHeader(const std::uint8_t* item)
+  {
+    type_ = (std::uint16_t(item[0]) << 8) | item[1];
+    numTracks_ = (std::uint16_t(item[2]) << 8) | item[3];
+    td_.setRaw(item[4], item[5]);
+    pending_.clear();
+    files_++;
+    track_ = 0;
+    state_ = (remaining_ == 0) ? CHUNK_HEADER : SKIP;
+  }
+
+  //Decodes as many events of the current track as possible
+  //Returns false if it needs more input
+  bool StreamParser::trackEvents(const std::uint8_t* & pos, const std::uint8_t* end)
+  {
+    while (remaining_ > 0)
+      {
+        //Events are read from the input directly unless one was split
+        const std::uint8_t* base;
+        std::size_t avail;
+        bool direct = pending_.empty();
+        if (direct)
+          {
+            base = pos;
+            avail = std::min<std::size_t>(remaining_, end - pos);
+          }
+        else
+          {
+            base = pending_.data();
+            avail = pending_.size();
+          }
+
+        std::size_t length;
+        int result = measureEvent(base, avail, runningStatus_, length);
+        if (result < 0 || length > remaining_)
+          {
+            failed_ = true;
+            return false;
+          }
+
+        if (result == 0)
+          {
+            //Hold on to what we have and take only what this event needs
+            if (direct)
+              {
+                pending_.assign(pos, pos + avail);
+                pos += avail;
+              }
+            else
+              {
+                std::size_t take = std::min<std::size_t>(length - pending_.size(), end - pos);
+                pending_.insert(pending_.end(), pos, pos + take);
+                pos += take;
+              }
+            if (pending_.size() < length) return false;
+            continue;
+          }
+
+        //Decode and hand off the complete event
+        const std::uint8_t* p = base;
+        Event* ev = readEvent(p, base + length, runningStatus_);
+        if (ev == NULL)
+          {
+            failed_ = true;
+            return false;
+          }
+        callback_(*ev, track_ - 1);
+        delete ev;
+
+        if (direct) pos += length;
+        else pending_.clear();
+        remaining_ -= length;
+        if (pos == end && remaining_ > 0) return false;
+      }
+
+    state_ = CHUNK_HEADER;
+    return true;
+  }
+
+} //Namespace
@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----StreamParser Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the StreamParser class, which decodes Standard MIDI
+  File bytes incrementally as they arrive in arbitrary pieces.
+*/
+
+#ifndef _streamparser_hpp_
+#define _streamparser_hpp_
+
+#include "event.hpp"
+#include "timedivision.hpp"
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+namespace midi
+{
+
+  class StreamParser
+  {
+  public:
+    //Called once for every complete event along with the index of its track
+    //within the current file. The event is only valid during the call.
+    typedef std::function<void(const Event &, std::size_t)> EventCallback;
+
+    StreamParser(EventCallback callback);
+
+    //Parses the next piece of input. Returns false once the input is invalid.
+    bool feed(const std::uint8_t* data, std::size_t size);
+
+    //Forget all state and start again at the beginning of a file
+    void reset();
+
+    //Accessors
+    bool failed() const {return failed_;}
+    std::uint16_t type() const {return type_;}
+    std::uint16_t numTracks() const {return numTracks_;}
+    const TimeDivision & timeDivision() const {return td_;}
+    std::size_t filesStarted() const {return files_;}
+
+  private:
+    enum State {CHUNK_HEADER, FILE_HEADER, TRACK, SKIP};
+
+    //Gathers exactly need bytes, from the input directly if possible
+    bool gather(const std::uint8_t* & pos, const std::uint8_t* end,
+                std::size_t need, const std::uint8_t* & item);
+
+    //Handles a complete chunk header or file header
+    void chunkHeader(const std::uint8_t* item);
+    void fileHeader(const std::uint8_t* item);
+
+    //Decodes as many events of the current track as possible
+    bool trackEvents(const std::uint8_t* & pos, const std::uint8_t* end);
+
+    EventCallback callback_;
+    State state_;
+    bool failed_;
+
+    //Bytes left in the current chunk
+    std::uint32_t remaining_;
+
+    //Bytes of an item split across inputs
+    std::vector<std::uint8_t> pending_;
+
+    //Most recent file header and decoding state
+    std::uint16_t type_;
+    std::uint16_t numTracks_;
+    TimeDivision td_;
+    std::size_t files_;
+    std::size_t track_;
+    std::uint8_t runningStatus_;
+  };
+
+} //Namespace
+
+#endif
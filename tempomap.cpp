@@ -0,0 +1,192 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----TempoMap Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the TempoMap class, which converts between
+  ticks and real time.
+*/
+
+#include "tempomap.hpp"
+
+#include <algorithm>
+
+namespace midi
+{
+
+  //Orders tempo changes by tick alone, so sorting keeps the order within a tick
+  static bool earlierChange(const std::pair<std::uint32_t, std::uint32_t> & a,
+                            const std::pair<std::uint32_t, std::uint32_t> & b)
+  {
+    return a.first < b.first;
+  }
+
+  //Constructors
+  TempoMap::TempoMap(const TimeDivision & td)
+  {
+    init(td);
+  }
+
+  TempoMap::TempoMap(const EventTrack & track, const TimeDivision & td)
+  {
+    init(td);
+    std::vector<std::pair<std::uint32_t, std::uint32_t> > changes;
+    findTempos(track, changes);
+    for (std::size_t i = 0; i < changes.size(); i++)
+      {
+        setTempo(changes[i].first, changes[i].second);
+      }
+  }
+
+  //Tempo changes may be in any track, so they're gathered then put in order
+  TempoMap::TempoMap(const MIDI & mid)
+  {
+    init(mid.timeDivision());
+    std::vector<std::pair<std::uint32_t, std::uint32_t> > changes;
+    for (std::size_t i = 0; i < mid.numTracks(); i++)
+      {
+        //Tracks of notes never have tempo changes
+        const EventTrack* events = dynamic_cast<const EventTrack*>(&mid.track(i));
+        const CompactTrack* compact = dynamic_cast<const CompactTrack*>(&mid.track(i));
+        if (events != NULL) findTempos(*events, changes);
+        else if (compact != NULL) findTempos(*compact, changes);
+      }
+
+    std::stable_sort(changes.begin(), changes.end(), earlierChange);
+    for (std::size_t i = 0; i < changes.size(); i++)
+      {
+        setTempo(changes[i].first, changes[i].second);
+      }
+  }
+
+  //Sets up the first segment and divisor for the time division
+  void TempoMap::init(const TimeDivision & td)
+  {
+    smpte_ = td.smpte();
+    Segment first;
+    first.tick = 0;
+    first.start = 0;
+    if (!smpte_)
+      {
+        //Each tick is mspq / ppqn microseconds
+        first.rate = DEFAULT_TEMPO;
+        divisor_ = td.ppqn() == 0 ? 1 : td.ppqn();
+      }
+    else if (td.fps() == 29)
+      {
+        //29.97 frames per second
+        first.rate = 100000000;
+        divisor_ = 2997 * std::uint64_t(td.ticksPerFrame());
+      }
+    else
+      {
+        first.rate = 1000000;
+        divisor_ = std::uint64_t(td.fps()) * td.ticksPerFrame();
+      }
+    if (divisor_ == 0) divisor_ = 1;
+    segment_.assign(1, first);
+  }
+
+  //Appends the tempo changes of a track to changes
+  void TempoMap::findTempos(const EventTrack & track,
+                            std::vector<std::pair<std::uint32_t, std::uint32_t> > & changes)
+  {
+    std::uint32_t tick = 0;
+    for (std::size_t i = 0; i < track.event().size(); i++)
+      {
+        const Event* ev = track.event()[i];
+        tick += ev->dt();
+        const MetaEvent* meta = dynamic_cast<const MetaEvent*>(ev);
+        if (meta == NULL || meta->metaType() != 0x51 || meta->payload().size() != 3) continue;
+
+        const Payload & p = meta->payload();
+        changes.push_back(std::make_pair(tick, (std::uint32_t(p[0]) << 16) |
+                                         (std::uint32_t(p[1]) << 8) | p[2]));
+      }
+  }
+
+  void TempoMap::findTempos(const CompactTrack & track,
+                            std::vector<std::pair<std::uint32_t, std::uint32_t> > & changes)
+  {
+    std::uint32_t tick = 0;
+    for (std::size_t i = 0; i < track.count(); i++)
+      {
+        const CompactEvent & ev = track.event()[i];
+        tick += ev.deltaTime;
+        if (ev.status != 0xFF || ev.param1 != 0x51 || ev.length != 3) continue;
+
+        const std::uint8_t* p = track.payload(i);
+        changes.push_back(std::make_pair(tick, (std::uint32_t(p[0]) << 16) |
+                                         (std::uint32_t(p[1]) << 8) | p[2]));
+      }
+  }
+
+  //Adds a tempo change, recomputing the start of every segment after it
+  void TempoMap::setTempo(std::uint32_t tick, std::uint32_t mspq)
+  {
+    if (smpte_ || mspq == 0) return;
+
+    //Find where it goes, replacing any change at the same tick
+    std::size_t i = segment_.size();
+    while (i > 0 && segment_[i-1].tick > tick) i--;
+    if (i > 0 && segment_[i-1].tick == tick) segment_[i-1].rate = mspq;
+    else
+      {
+        Segment seg;
+        seg.tick = tick;
+        seg.rate = mspq;
+        segment_.insert(segment_.begin() + i, seg);
+        i++;
+      }
+
+    for (std::size_t j = i > 1 ? i - 1 : 1; j < segment_.size(); j++)
+      {
+        segment_[j].start = scaledTime(segment_[j-1], segment_[j].tick);
+      }
+  }
+
+  //Tick to microseconds
+  std::uint64_t TempoMap::microseconds(std::uint32_t tick) const
+  {
+    //Last segment starting at or before the tick
+    std::size_t low = 0, high = segment_.size();
+    while (high - low > 1)
+      {
+        std::size_t mid = (low + high) / 2;
+        if (segment_[mid].tick <= tick) low = mid;
+        else high = mid;
+      }
+    return scaledTime(segment_[low], tick) / divisor_;
+  }
+
+  //Microseconds to the last tick starting at or before them
+  std::uint32_t TempoMap::tick(std::uint64_t microseconds) const
+  {
+    std::uint64_t scaled = microseconds * divisor_;
+    std::size_t low = 0, high = segment_.size();
+    while (high - low > 1)
+      {
+        std::size_t mid = (low + high) / 2;
+        if (segment_[mid].start <= scaled) low = mid;
+        else high = mid;
+      }
+    const Segment & seg = segment_[low];
+    return seg.tick + (scaled - seg.start) / seg.rate;
+  }
+
+  //Converts ascending ticks, moving through the segments alongside them
+  void TempoMap::microseconds(const std::uint32_t* ticks, std::size_t count,
+                              std::uint64_t* out) const
+  {
+    std::size_t seg = 0;
+    for (std::size_t i = 0; i < count; i++)
+      {
+        while (seg + 1 < segment_.size() && segment_[seg+1].tick <= ticks[i]) seg++;
+        out[i] = scaledTime(segment_[seg], ticks[i]) / divisor_;
+      }
+  }
+
+} //Namespace
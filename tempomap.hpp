@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----TempoMap Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the TempoMap class, which converts between ticks and
+  real time using the tempo changes of a MIDI and its time division.
+*/
+
+#ifndef _tempomap_hpp_
+#define _tempomap_hpp_
+
+#include "midi.hpp"
+#include "compacttrack.hpp"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+namespace midi
+{
+
+  class TempoMap
+  {
+  public:
+    //Until the first tempo change, the tempo is 500000 microseconds per
+    //quarter note (120 bpm). SMPTE time divisions ignore tempo entirely.
+    static const std::uint32_t DEFAULT_TEMPO = 500000;
+
+    //Builds the map from the Set Tempo events of a track or of every track of
+    //a MIDI, in one pass. Type 2 MIDIs have a tempo map per track.
+    TempoMap(const TimeDivision & td);
+    TempoMap(const EventTrack & track, const TimeDivision & td);
+    TempoMap(const MIDI & mid);
+
+    //Adds a tempo change, in microseconds per quarter note, at a tick
+    void setTempo(std::uint32_t tick, std::uint32_t mspq);
+
+    //Conversions, O(log n) in the number of tempo changes
+    std::uint64_t microseconds(std::uint32_t tick) const;
+    std::uint32_t tick(std::uint64_t microseconds) const;
+
+    //Converts count ticks in ascending order at once, in O(n)
+    void microseconds(const std::uint32_t* ticks, std::size_t count,
+                      std::uint64_t* out) const;
+
+    //Number of stretches of constant tempo
+    std::size_t segments() const {return segment_.size();}
+
+  private:
+    //A stretch of constant tempo. Times are kept in units of 1/divisor_
+    //microseconds so the sums are exact.
+    struct Segment
+    {
+      std::uint32_t tick;
+      std::uint32_t rate;
+      std::uint64_t start;
+    };
+
+    //Appends the tempo changes of a track to changes
+    static void findTempos(const EventTrack & track,
+                           std::vector<std::pair<std::uint32_t, std::uint32_t> > & changes);
+    static void findTempos(const CompactTrack & track,
+                           std::vector<std::pair<std::uint32_t, std::uint32_t> > & changes);
+
+    //Sets up the first segment and divisor for the time division
+    void init(const TimeDivision & td);
+
+    //Converts within one segment
+    std::uint64_t scaledTime(const Segment & seg, std::uint32_t tick) const
+    {return seg.start + std::uint64_t(tick - seg.tick)*seg.rate;}
+
+    std::vector<Segment> segment_;
+    std::uint64_t divisor_;
+    bool smpte_;
+  };
+
+} //Namespace
+
+#endif
@@ -10,15 +10,45 @@
 */
 
 #include "midi.hpp"
+#include "streamparser.hpp"
+#include "compacttrack.hpp"
+#include "tickscan.hpp"
+#include "tempomap.hpp"
+#include "sequencer.hpp"
+#include "liveparser.hpp"
+#include "threadpool.hpp"
+#include "notecache.hpp"
+#include "validator.hpp"
 #include "instruments.hpp"
 #include "scales.hpp"
 #include "chords.hpp"
 
 #include <iostream>
 #include <string>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
 
 using namespace midi;
 
+//Collects the events given by a StreamParser into tracks
+struct StreamCollector
+{
+  std::map<std::size_t, EventTrack> tracks;
+  void operator()(const Event & ev, std::size_t track)
+  {
+    tracks[track].add(ev);
+  }
+};
+
 void displayAndReset(bool & pass, int & fail, std::string id)
 {
   if (pass)
@@ -89,6 +119,29 @@ int main()
 
   displayAndReset(pass, fail, "VL06");
 
+  //VL07: Compile time encoding
+  static_assert(VarLength(0x7F).size() == 1 && VarLength(0x80).size() == 2, "VL07");
+  static_assert(VarLength(0x0FFFFFFF).size() == 4 && VarLength::size(0x200000) == 4, "VL07");
+  static_assert(VarLength(0x3FFF)[0] == 0xFF && VarLength(0x3FFF)[1] == 0x7F, "VL07");
+  static_assert(std::uint32_t(VarLength(0x0ABCDEF1)) == 0x0ABCDEF1, "VL07");
+  std::uint8_t vl7bytes[4];
+  if (VarLength(0x0FFFFFFF).encodeInto(vl7bytes) != vl7bytes + 4) pass = false;
+  if (vl7bytes[0] != 0xFF || vl7bytes[3] != 0x7F) pass = false;
+
+  displayAndReset(pass, fail, "VL07");
+
+  //VL08: Bulk encoding and decoding
+  std::uint32_t vl8values[] = {0, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF, 0x200000, 0x0FFFFFFF};
+  std::uint8_t vl8bytes[32];
+  std::uint8_t* vl8end = encodeVarLengths(vl8values, 8, vl8bytes);
+  if (vl8end != vl8bytes + 20) pass = false;
+  std::uint32_t vl8decoded[8];
+  if (decodeVarLengths(vl8bytes, vl8end, vl8decoded, 8) != vl8end) pass = false;
+  if (!std::equal(vl8values, vl8values + 8, vl8decoded)) pass = false;
+  if (decodeVarLengths(vl8bytes, vl8end - 1, vl8decoded, 8) != NULL) pass = false;
+
+  displayAndReset(pass, fail, "VL08");
+
   //-----NOTE AND CHORD TESTS-----//
   std::cout << std::endl << "--NOTE AND CHORD TESTS--" << std::endl;
 
@@ -170,6 +223,41 @@ int main()
   if (ch3.contains(5)) pass = false;
   displayAndReset(pass, fail, "NC12");
 
+  //NC13: Iterating a chord's notes in order
+  Chord ch4(Note(127), Note(0), Note(64), Note(63), Note(60));
+  if (ch4.size() != 5 || ch4.notes().empty()) pass = false;
+  int ch4expected[] = {0, 60, 63, 64, 127};
+  std::size_t ch4count = 0;
+  for (Chord::const_iterator i = ch4.notes().begin(); i != ch4.notes().end(); i++)
+    {
+      if (ch4count >= 5 || *i != ch4expected[ch4count]) pass = false;
+      ch4count++;
+    }
+  if (ch4count != 5) pass = false;
+  if (ch4.add(Note(-1)) || ch4.contains(Note(-1))) pass = false;
+  displayAndReset(pass, fail, "NC13");
+
+  //NC14: Union, intersection, and transposition
+  Chord ch5 = majTriad(Note(60));
+  Chord ch6 = minTriad(Note(60));
+  if ((ch5 | ch6).size() != 4 || (ch5 & ch6).size() != 2) pass = false;
+  if (!(ch5 & ch6).contains(Note(67))) pass = false;
+  if (ch5.transpose(2) != majTriad(Note(62))) pass = false;
+  if (ch5.transpose(-60) != majTriad(Note(0))) pass = false;
+  if (ch5.transpose(64) != Chord(Note(124))) pass = false;
+  if (ch4.transpose(-64) != Chord(Note(0), Note(63))) pass = false;
+  if (ch4.transpose(1).transpose(-1) != Chord(Note(0), Note(60), Note(63), Note(64))) pass = false;
+  if (ch5.transpose(128).size() != 0 || ch5.transpose(0) != ch5) pass = false;
+  displayAndReset(pass, fail, "NC14");
+
+  //NC15: Compile time notes and chords
+  static_assert("C4"_note == 48 && "c#4"_note == 49 && "Bb9"_note == 118, "NC15");
+  static_assert(Note("A8").midiVal() == 105 && Note("C11").midiVal() == 0, "NC15");
+  static_assert(majTriad("C4"_note) == Chord(48, 52, 55), "NC15");
+  static_assert((majTriad(48) & minTriad(48)) == Chord(48, 55), "NC15");
+  if (Note(std::string("G#3")) != "G#3"_note || "G#3"_note != 44) pass = false;
+  displayAndReset(pass, fail, "NC15");
+
   //-----TIMEDIVISION TESTS-----//
   std::cout << std::endl << "--TIMEDIVISION TESTS--" << std::endl;
 
@@ -317,6 +405,54 @@ int main()
   if (ev8.dt() != 123456) pass = false;
   displayAndReset(pass, fail, "EV11");
 
+  //EV12: Two-parameter channel events keep a zero second parameter
+  ControllerEvent ev12(0, 0, 7, 0);
+  if (ev12.size() != 4) pass = false;
+  if (ev12.data().size() != 4) pass = false;
+  if (ev12.data()[3] != 0) pass = false;
+  NoteOnEvent ev12a(0, 0, 60, 0);
+  if (ev12a.size() != 4) pass = false;
+  displayAndReset(pass, fail, "EV12");
+
+  //EV13: Reading events back from raw bytes
+  std::uint8_t ev13bytes[] = {0x00, 0x90, 60, 100, 0x10, 62, 0,
+                              0x00, 0xFF, 0x01, 0x02, 'h', 'i'};
+  const std::uint8_t* ev13pos = ev13bytes;
+  const std::uint8_t* ev13end = ev13bytes + sizeof(ev13bytes);
+  std::uint8_t ev13status = 0;
+  Event* ev13 = readEvent(ev13pos, ev13end, ev13status);
+  if (ev13 == NULL || ev13->getNote() != 60 || ev13->size() != 4) pass = false;
+  delete ev13;
+  ev13 = readEvent(ev13pos, ev13end, ev13status);
+  if (ev13 == NULL || ev13->dt() != 16 || ev13->getNote() != 62) pass = false;
+  delete ev13;
+  ev13 = readEvent(ev13pos, ev13end, ev13status);
+  if (ev13 == NULL || ev13->size() != 6 || ev13->data()[5] != 'i') pass = false;
+  if (ev13 != NULL && !static_cast<MetaEvent*>(ev13)->payload().isView()) pass = false;
+  if (ev13pos != ev13end) pass = false;
+  delete ev13;
+  ev13pos = ev13bytes + 4;
+  std::uint8_t ev13none = 0;
+  if (readEvent(ev13pos, ev13end, ev13none) != NULL) pass = false;
+  displayAndReset(pass, fail, "EV13");
+
+  //EV14: Encoding into caller-owned memory
+  std::vector<std::uint8_t> ev14;
+  ev3.encodeInto(ev14);
+  ev5.encodeInto(ev14);
+  ev8a.encodeInto(ev14);
+  if (ev14.size() != ev3.size() + ev5.size() + ev8a.size()) pass = false;
+  std::vector<std::uint8_t> ev14expected = ev3.data();
+  std::vector<std::uint8_t> ev14part = ev5.data();
+  ev14expected.insert(ev14expected.end(), ev14part.begin(), ev14part.end());
+  ev14part = ev8a.data();
+  ev14expected.insert(ev14expected.end(), ev14part.begin(), ev14part.end());
+  if (ev14 != ev14expected) pass = false;
+  std::uint8_t ev14buffer[8];
+  if (ev5.encodeInto(ev14buffer) != ev14buffer + 8) pass = false;
+  if (ev14buffer[2] != 0xFF || ev14buffer[7] != 'c') pass = false;
+  displayAndReset(pass, fail, "EV14");
+
   //-----TRACK TESTS-----//
   std::cout << std::endl << "--TRACK TESTS--" << std::endl;
 
@@ -441,6 +577,244 @@ int main()
   delete et3;
   displayAndReset(pass, fail, "TR07");
 
+  //TR08: Running status encoding
+  EventTrack et4;
+  et4.add(NoteOnEvent(0, 0, 48, 100));
+  et4.add(NoteOnEvent(0, 0, 50, 100));
+  et4.add(NoteOffEvent(10, 0, 48, 64));
+  et4.add(NoteOffEvent(0, 1, 50, 64));
+  et4.add(TextEvent("a"));
+  et4.add(NoteOnEvent(0, 1, 52, 1));
+  if (et4.size() != 33) pass = false;
+  et4.setRunningStatus(true);
+  std::uint8_t et4expected[] = {'M', 'T', 'r', 'k', 0, 0, 0, 23,
+                                0x00, 0x90, 48, 100,
+                                0x00, 50, 100,
+                                0x0A, 48, 0,
+                                0x00, 0x91, 50, 0,
+                                0x00, 0xFF, 0x01, 0x01, 'a',
+                                0x00, 0x91, 52, 1};
+  if (et4.size() != sizeof(et4expected)) pass = false;
+  std::vector<std::uint8_t> et4data = et4.data();
+  if (et4data != std::vector<std::uint8_t>(et4expected, et4expected + sizeof(et4expected)))
+    pass = false;
+  Track* et4clone = et4.clone();
+  if (et4clone->size() != et4.size()) pass = false;
+  delete et4clone;
+  displayAndReset(pass, fail, "TR08");
+
+  //TR09: Running status data reads back
+  const std::uint8_t* et5pos = &et4data[8];
+  const std::uint8_t* et5end = &et4data[0] + et4data.size();
+  std::uint8_t et5status = 0;
+  std::size_t et5count = 0;
+  while (et5pos != et5end)
+    {
+      Event* ev = readEvent(et5pos, et5end, et5status);
+      if (ev == NULL)
+        {
+          pass = false;
+          break;
+        }
+      if (et5count == 2 && (ev->dt() != 10 || ev->getNote() != 48)) pass = false;
+      et5count++;
+      delete ev;
+    }
+  if (et5count != 6) pass = false;
+  displayAndReset(pass, fail, "TR09");
+
+  //TR10: Copying and moving tracks
+  EventTrack et6(et4);
+  if (et6.data() != et4.data() || et6.event()[0] == et4.event()[0]) pass = false;
+  EventTrack et7(std::move(et6));
+  if (et7.data() != et4.data() || et6.event().size() != 0) pass = false;
+  et6 = et7;
+  if (et6.data() != et7.data() || !et6.runningStatus()) pass = false;
+  const Event* et7first = et7.event()[0];
+  et6 = std::move(et7);
+  if (et6.event()[0] != et7first || et7.event().size() != 0) pass = false;
+  Track* et6moved = et6.moveClone();
+  if (et6moved->data() != et4.data() || et6.event().size() != 0) pass = false;
+  delete et6moved;
+  displayAndReset(pass, fail, "TR10");
+
+  //TR11: Note pairing by channel, with velocity 0 Note Ons ending notes
+  EventTrack et8;
+  et8.add(NoteOnEvent(0, 0, 60, 100));
+  et8.add(NoteOnEvent(1, 1, 60, 100));
+  et8.add(NoteOffEvent(2, 1, 60, 0));
+  et8.add(NoteOnEvent(3, 0, 60, 0));
+  et8.add(NoteOnEvent(0, 0, 62, 100));
+  et8.add(NoteOnEvent(1, 0, 62, 100));
+  et8.add(NoteOffEvent(1, 0, 62, 0));
+  et8.add(NoteOffEvent(1, 0, 62, 0));
+  et8.add(NoteOnEvent(0, 2, 64, 100));
+  NoteTrack nt8 = et8.toNotes();
+  if (nt8.note().size() != 4) pass = false;
+  else
+    {
+      if (nt8.note()[0].begin != 0 || nt8.note()[0].duration != 6) pass = false;
+      if (nt8.note()[1].begin != 1 || nt8.note()[1].duration != 2) pass = false;
+      if (nt8.note()[2].note != 62 || nt8.note()[2].begin != 6 ||
+          nt8.note()[2].duration != 2) pass = false;
+      if (nt8.note()[3].begin != 7 || nt8.note()[3].duration != 2) pass = false;
+    }
+  displayAndReset(pass, fail, "TR11");
+
+  //TR12: Event ordering from a NoteTrack
+  NoteTrack nt9;
+  nt9.add(Note(60), 70000, 300, Instrument::VIOLIN);
+  nt9.add(Note(60), 10, 10);
+  nt9.add(Note(60), 0, 10);
+  nt9.add(Note(62), 5, 0);
+  nt9.add(Note(64), 256, 65536, Instrument::VIOLIN);
+  EventTrack et9 = nt9.toEvents();
+  if (et9.event().size() != 14) pass = false;
+  else
+    {
+      //Time signature and two program changes first
+      if (et9.event()[1]->size() != 3 || et9.event()[2]->size() != 3) pass = false;
+      std::uint16_t et9notes[] = {60, 62, 62+128, 60+128, 60, 60+128, 64, 64+128, 60, 60+128};
+      std::uint32_t et9dts[] = {0, 5, 0, 5, 0, 10, 236, 65536, 4208, 300};
+      for (std::size_t i = 0; i < 10; i++)
+        {
+          if (et9.event()[i+3]->getNote() != et9notes[i]) pass = false;
+          if (et9.event()[i+3]->dt() != et9dts[i]) pass = false;
+        }
+    }
+  displayAndReset(pass, fail, "TR12");
+
+  //TR13: Cached encoding follows changes
+  NoteTrack nt10;
+  std::size_t nt10empty = nt10.size();
+  nt10.add(Note(60), 0, 10);
+  if (nt10.size() == nt10empty || nt10.size() != nt10.toEvents().size()) pass = false;
+  std::vector<std::uint8_t> nt10data = nt10.data();
+  nt10.add(Note(62), 10, 10);
+  if (nt10.data() == nt10data || nt10.data() != nt10.toEvents().data()) pass = false;
+  NoteTrack nt10copy(nt10);
+  nt10.clear();
+  if (nt10.size() != nt10empty || nt10copy.data() != nt10copy.toEvents().data()) pass = false;
+  NoteTrack nt10moved(std::move(nt10copy));
+  if (nt10copy.size() != nt10empty || nt10moved.note().size() != 2) pass = false;
+  displayAndReset(pass, fail, "TR13");
+
+  //TR14: Track extents and chords after the last press
+  NoteTrack nt11;
+  if (nt11.lastPress() != 0 || nt11.lastRelease() != 0) pass = false;
+  nt11.add(Note(60), 100, 50, Instrument::VIOLIN);
+  nt11.add(Note(60), 20, 500);
+  nt11.addAfterLastPress(majTriad(Note(48)), 10, 20);
+  if (nt11.lastPress() != 110 || nt11.lastRelease() != 520) pass = false;
+  if (nt11.instrumentCount(Instrument::VIOLIN) != 1) pass = false;
+  if (nt11.instrumentCount(Instrument::ACOUSTIC_GRAND_PIANO) != 4) pass = false;
+  for (std::size_t i = 2; i < nt11.note().size(); i++)
+    {
+      if (nt11.note()[i].begin != 110) pass = false;
+    }
+  nt11.clear();
+  if (nt11.lastPress() != 0 || nt11.instrumentCount(Instrument::VIOLIN) != 0) pass = false;
+  displayAndReset(pass, fail, "TR14");
+
+  //TR15: Seeking by absolute time, with and without the index
+  NoteTrack nt12;
+  for (std::uint32_t i = 0; i < 40; i++)
+    {
+      nt12.add(Note(int(40 + i)), i*i*7, 300);
+    }
+  EventTrack et12 = nt12.toEvents();
+  EventTrack et12indexed(et12);
+  et12indexed.setIndexed(true);
+  et12indexed.add(NoteOnEvent(100, 0, 60, 100));
+  et12.add(NoteOnEvent(100, 0, 60, 100));
+  if (!et12indexed.indexed() || et12.indexed()) pass = false;
+  std::uint32_t et12end = et12.time(et12.event().size() - 1);
+  for (std::uint32_t t = 0; t <= et12end + 1; t += 250)
+    {
+      std::size_t i = et12.lowerBound(t);
+      if (et12indexed.lowerBound(t) != i) pass = false;
+      if (i < et12.event().size() && et12.time(i) < t) pass = false;
+      if (i > 0 && et12.time(i-1) >= t) pass = false;
+      if (et12indexed.seek(t) != et12indexed.event().begin() + i) pass = false;
+    }
+  EventTrack et12range = et12indexed.range(1000, 8000);
+  std::size_t et12first = et12.lowerBound(1000);
+  if (et12range.event().size() != et12.lowerBound(8000) - et12first) pass = false;
+  else if (!et12range.event().empty())
+    {
+      if (et12range.time(0) != et12.time(et12first) - 1000) pass = false;
+      std::size_t last = et12range.event().size() - 1;
+      if (et12range.time(last) != et12.time(et12first + last) - 1000) pass = false;
+    }
+  if (et12.range(8000, 1000).event().size() != 0) pass = false;
+  et12indexed.clear();
+  if (et12indexed.lowerBound(0) != 0) pass = false;
+  displayAndReset(pass, fail, "TR15");
+
+  //TR16: Normalizing orders each tick and leaves one End of Track at the end
+  EventTrack et16;
+  et16.add(NoteOnEvent(0, 0, 60, 100));
+  et16.add(EndOfTrackEvent(10));
+  et16.add(NoteOffEvent(10, 0, 60, 0));
+  et16.add(NoteOnEvent(0, 1, 62, 90));
+  et16.add(ControllerEvent(0, 1, 7, 100));
+  et16.add(NoteOnEvent(0, 0, 64, 0));
+  et16.add(NormalSysExEvent(0, std::vector<std::uint8_t>(2, 0x11)));
+  et16.add(SetTempoEvent(0, 400000));
+  et16.add(NoteOffEvent(5, 1, 62, 0));
+  EventTrack et16n = et16.normalized();
+  const std::vector<Event*> & et16ev = et16n.event();
+  if (et16ev.size() != 9) pass = false;
+  else
+    {
+      if (dynamic_cast<const SetTempoEvent*>(et16ev[1]) == NULL || et16ev[1]->dt() != 20) pass = false;
+      if (dynamic_cast<const NormalSysExEvent*>(et16ev[2]) == NULL) pass = false;
+      if (dynamic_cast<const NoteOffEvent*>(et16ev[3]) == NULL || et16ev[3]->getNote() != 188) pass = false;
+      if (dynamic_cast<const NoteOnEvent*>(et16ev[4]) == NULL || et16ev[4]->getNote() != 64) pass = false;
+      if (dynamic_cast<const ControllerEvent*>(et16ev[5]) == NULL) pass = false;
+      if (dynamic_cast<const NoteOnEvent*>(et16ev[6]) == NULL || et16ev[6]->getNote() != 62) pass = false;
+      if (dynamic_cast<const NoteOffEvent*>(et16ev[7]) == NULL || et16ev[7]->dt() != 5) pass = false;
+      if (dynamic_cast<const EndOfTrackEvent*>(et16ev[8]) == NULL || et16ev[8]->dt() != 0) pass = false;
+      for (std::size_t i = 1; i < 8; i++)
+        {
+          if (i != 1 && i != 7 && et16ev[i]->dt() != 0) pass = false;
+        }
+    }
+  if (et16n.toNotes().note().size() != et16.toNotes().note().size()) pass = false;
+  std::vector<std::uint8_t> et16data = MIDI_Type0(et16n, TimeDivision(96)).data();
+  if (!validate(&et16data[0], et16data.size()).ok()) pass = false;
+  EventTrack et16late;
+  et16late.add(NoteOnEvent(0, 0, 60, 100));
+  et16late.add(EndOfTrackEvent(30));
+  EventTrack et16laten = et16late.normalized();
+  if (et16laten.event().size() != 2 || et16laten.event()[1]->dt() != 30) pass = false;
+  if (EventTrack().normalized().event().size() != 1) pass = false;
+  displayAndReset(pass, fail, "TR16");
+
+  //TR17: Threads sharing a NoteTrack all get the same encoding
+  NoteTrack nt17;
+  for (std::uint32_t i = 0; i < 2000; i++)
+    {
+      nt17.add(Note(int(40 + i % 40)), i * 10, 15);
+    }
+  EventTrack nt17events = nt17.toEvents();
+  std::vector<std::uint8_t> nt17expected = nt17events.data();
+  if (!nt17events.arena() || nt17events.event().size() != 4003) pass = false;
+  std::vector<std::vector<std::uint8_t> > nt17data(4);
+  std::vector<std::thread> nt17threads;
+  for (std::size_t i = 0; i < nt17data.size(); i++)
+    {
+      nt17threads.push_back(std::thread([&nt17, &nt17data, i]() {nt17data[i] = nt17.data();}));
+    }
+  for (std::size_t i = 0; i < nt17threads.size(); i++)
+    {
+      nt17threads[i].join();
+      if (nt17data[i] != nt17expected) pass = false;
+    }
+  NoteTrack nt17copy(nt17);
+  if (nt17copy.size() != nt17expected.size() || nt17copy.data() != nt17expected) pass = false;
+  displayAndReset(pass, fail, "TR17");
+
   //-----MIDI TESTS-----//
   std::cout << std::endl << "--MIDI TESTS--" << std::endl;
 
@@ -524,7 +898,7 @@ int main()
   nt4.add(NoteOffEvent(0, 1, 54, 127));
   nt4.add(EndOfTrackEvent(0));
   MIDI_Type0 md4(nt4, TimeDivision(26, 20));
-  md4.write("test.mid");
+  if (!md4.write("test.mid")) pass = false;
   displayAndReset(pass, fail, "MD04");
   std::cout << "  Try playing test.mid!" << std::endl;
 
@@ -538,7 +912,7 @@ int main()
   MIDI_Type1 md5(TimeDivision(25,120));
   md5.addTrack(nt4);
   md5.addTrack(nt5);
-  md5.write("test2.mid");
+  if (!md5.write("test2.mid")) pass = false;
   displayAndReset(pass, fail, "MD05");
   std::cout << "  Try playing test2.mid!" << std::endl;
 
@@ -572,7 +946,7 @@ int main()
 
   MIDI_Type1 md6(TimeDivision(25,120));
   md6.addTrack(nt6);
-  md6.write("test3.mid");
+  if (!md6.write("test3.mid")) pass = false;
   displayAndReset(pass, fail, "MD06");
   std::cout << "  Try playing test3.mid!" << std::endl;
 
@@ -595,10 +969,999 @@ int main()
   nt7.add("G4", 0, 10000);
 
   MIDI_Type0 md7(nt7, TimeDivision(26, 20));
-  md7.write("test4.mid");
+  if (!md7.write("test4.mid")) pass = false;
   displayAndReset(pass, fail, "MD07");
   std::cout << "  Try playing test4.mid!" << std::endl;
 
+  //MD08: Streaming into a fixed buffer
+  std::vector<std::uint8_t> md8data = md5.data();
+  std::vector<std::uint8_t> md8buffer(md5.size());
+  BufferSink md8sink(&md8buffer[0], md8buffer.size());
+  if (!md5.write(md8sink)) pass = false;
+  if (md8sink.used() != md8data.size() || md8buffer != md8data) pass = false;
+  BufferSink md8small(&md8buffer[0], md8buffer.size() - 1);
+  if (md5.write(md8small)) pass = false;
+  displayAndReset(pass, fail, "MD08");
+
+  //MD09: Streaming into an output stream
+  std::ostringstream md9out;
+  StreamSink md9sink(md9out);
+  if (!md6.write(md9sink)) pass = false;
+  std::vector<std::uint8_t> md9data = md6.data();
+  if (md9out.str() != std::string(md9data.begin(), md9data.end())) pass = false;
+  displayAndReset(pass, fail, "MD09");
+
+  //MD10: Moving tracks into and MIDIs around
+  MIDI_Type1 md10(TimeDivision(96));
+  EventTrack md10track(et4);
+  const Event* md10first = md10track.event()[0];
+  md10.addTrack(std::move(md10track));
+  md10.addTrack(std::unique_ptr<Track>(new EventTrack(et4)));
+  md10.addTrack(nt7.toEvents());
+  if (md10.numTracks() != 3 || md10track.event().size() != 0) pass = false;
+  if (static_cast<const EventTrack&>(md10.track(0)).event()[0] != md10first) pass = false;
+  std::vector<std::uint8_t> md10data = md10.data();
+  MIDI_Type1 md10copy(md10);
+  if (md10copy.data() != md10data || &md10copy.track(0) == &md10.track(0)) pass = false;
+  MIDI_Type1 md10moved(std::move(md10));
+  if (md10moved.data() != md10data || md10.numTracks() != 0) pass = false;
+  MIDI_Type0 md10type0(EventTrack(et4), TimeDivision(96));
+  MIDI_Type0 md10type0b(std::move(md10type0));
+  if (md10type0.numTracks() != 0 || md10type0b.track(0).data() != et4.data()) pass = false;
+  if (md10type0.size() != 14 || md10type0.data().size() != 14) pass = false;
+  md10type0b.clear();
+  std::uint8_t md10header[14];
+  BufferSink md10sink(md10header, 14);
+  if (!md10type0b.write(md10sink) || md10header[11] != 0 || md10type0b.track(0).size() != 8) pass = false;
+  std::vector<std::unique_ptr<Track> > md10tracks;
+  md10tracks.push_back(std::unique_ptr<Track>(new EventTrack(et4)));
+  MIDI_Type2 md10type2(std::move(md10tracks), TimeDivision(96));
+  if (md10type2.numTracks() != 1 || md10type2.track(0).data() != et4.data()) pass = false;
+  displayAndReset(pass, fail, "MD10");
+
+  //MD11: Encoding tracks on a thread pool
+  ThreadPool md11pool(4);
+  MIDI_Type1 md11(TimeDivision(96));
+  for (std::size_t i = 0; i < 40; i++)
+    {
+      if (i % 3 == 0) md11.addTrack(et4);
+      else if (i % 3 == 1) md11.addTrack(nt9);
+      else md11.addTrack(CompactTrack(et4));
+    }
+  if (md11.data(md11pool) != md11.data()) pass = false;
+  if (md5.data(md11pool) != md5.data() || md10type2.data(md11pool) != md10type2.data()) pass = false;
+  MIDI_Type1 md11empty(TimeDivision(96));
+  if (md11empty.data(md11pool) != md11empty.data()) pass = false;
+
+  //NoteTracks whose encodings haven't been built yet
+  MIDI_Type1 md11notes(TimeDivision(96));
+  MIDI_Type1 md11notesSerial(TimeDivision(96));
+  for (std::uint32_t i = 0; i < 12; i++)
+    {
+      NoteTrack track;
+      for (std::uint32_t j = 0; j < 300; j++)
+        {
+          track.add(Note(int(30 + (i + j) % 60)), j * 7, 5 + i);
+        }
+      md11notes.addTrack(track);
+      md11notesSerial.addTrack(std::move(track));
+    }
+  if (md11notes.data(md11pool) != md11notesSerial.data()) pass = false;
+  displayAndReset(pass, fail, "MD11");
+
+  //MD12: Writes report failure, and streaming into a file descriptor
+  if (md5.write("no_such_directory/test.mid")) pass = false;
+#if defined(__unix__) || defined(__APPLE__)
+  int md12pipe[2];
+  if (pipe(md12pipe) != 0) pass = false;
+  else
+    {
+      //Bigger than the sink's buffer and the pipe's, so something has to read
+      std::vector<std::uint8_t> md12big(200000);
+      for (std::size_t i = 0; i < md12big.size(); i++)
+        {
+          md12big[i] = i * 7;
+        }
+      std::vector<std::uint8_t> md12read;
+      std::thread md12reader([&]()
+                             {
+                               std::uint8_t buf[4096];
+                               ssize_t got;
+                               while ((got = read(md12pipe[0], buf, sizeof(buf))) > 0)
+                                 md12read.insert(md12read.end(), buf, buf + got);
+                             });
+      {
+        FileDescriptorSink md12sink(md12pipe[1]);
+        if (!md5.write(md12sink)) pass = false;
+        if (!md12sink.write(&md12big[0], 10) || !md12sink.write(&md12big[10], 100000)) pass = false;
+        if (!md12sink.write(&md12big[100010], md12big.size() - 100010)) pass = false;
+        if (!md12sink.flush()) pass = false;
+      }
+      close(md12pipe[1]);
+      md12reader.join();
+      close(md12pipe[0]);
+      std::vector<std::uint8_t> md12expected = md5.data();
+      md12expected.insert(md12expected.end(), md12big.begin(), md12big.end());
+      if (md12read != md12expected) pass = false;
+    }
+  FileDescriptorSink md12closed(-1);
+  std::uint8_t md12byte = 0;
+  if (!md12closed.write(&md12byte, 1) || md12closed.flush()) pass = false;
+#endif
+  displayAndReset(pass, fail, "MD12");
+
+  //-----COMPACT TRACK TESTS-----//
+  std::cout << std::endl << "--COMPACT TRACK TESTS--" << std::endl;
+
+  //CT01: Construction from an EventTrack
+  CompactTrack ct1(nt4);
+  if (ct1.count() != nt4.event().size()) pass = false;
+  if (ct1.size() != nt4.size()) pass = false;
+  if (ct1.data() != nt4.data()) pass = false;
+  for (std::size_t i = 0; i < ct1.count(); i++)
+    {
+      if (ct1.dt(i) != nt4.event()[i]->dt()) pass = false;
+      if (ct1.getNote(i) != nt4.event()[i]->getNote()) pass = false;
+      if (ct1.eventSize(i) != nt4.event()[i]->size()) pass = false;
+    }
+  displayAndReset(pass, fail, "CT01");
+
+  //CT02: Reading raw track bytes, including running status
+  std::vector<std::uint8_t> ct2bytes = et4.data();
+  CompactTrack ct2;
+  if (!ct2.read(&ct2bytes[8], &ct2bytes[0] + ct2bytes.size())) pass = false;
+  if (ct2.count() != 6) pass = false;
+  if (ct2.event()[4].status != 0xFF || ct2.event()[4].param1 != 0x01) pass = false;
+  if (ct2.payload(4)[0] != 'a') pass = false;
+  et4.setRunningStatus(false);
+  if (ct2.size() != et4.size()) pass = false;
+  if (ct2.toEvents().data() != ct2.data()) pass = false;
+  if (ct2.read(&ct2bytes[9], &ct2bytes[0] + ct2bytes.size())) pass = false;
+  displayAndReset(pass, fail, "CT02");
+
+  //CT03: Clone and clear
+  Track* ct3 = ct1.clone();
+  if (ct3->data() != ct1.data()) pass = false;
+  delete ct3;
+  ct1.clear();
+  if (ct1.size() != 8 || ct1.count() != 0) pass = false;
+  displayAndReset(pass, fail, "CT03");
+
+  //CT04: Only channel status bytes are taken as channel events
+  CompactTrack ct4;
+  if (!ct4.addChannel(0, 0x93, 60, 100) || !ct4.add(ControllerEvent(5, 2, 7, 90))) pass = false;
+  if (ct4.addChannel(0, 0x40, 60, 100) || ct4.addChannel(0, 0xF0, 1, 2)) pass = false;
+  if (ct4.addChannel(0, 0xFF, 0x2F, 0)) pass = false;
+  if (!ct4.add(TextEvent(std::string(200, 'x')))) pass = false;
+  if (ct4.count() != 3 || ct4.payload(2)[199] != 'x') pass = false;
+  if (ct4.toEvents().data() != ct4.data()) pass = false;
+  displayAndReset(pass, fail, "CT04");
+
+  //CT05: Every kind of event packed directly, and streaming through a buffer
+  EventTrack ct5track;
+  ct5track.add(NoteOffEvent(1, 1, 60, 40));
+  ct5track.add(NoteAftertouchEvent(2, 2, 61, 50));
+  ct5track.add(ProgramChangeEvent(3, 3, Instrument::VIOLIN));
+  ct5track.add(ChannelAftertouchEvent(4, 4, 70));
+  ct5track.add(PitchBendEvent(5, 5, 0x1234));
+  ct5track.add(SetTempoEvent(0, 500000));
+  ct5track.add(NormalSysExEvent(7, std::vector<std::uint8_t>(10000, 0x33)));
+  ct5track.add(AuthorizationSysExEvent(0, std::vector<std::uint8_t>(3, 0x44)));
+  for (std::size_t i = 0; i < 3000; i++)
+    {
+      ct5track.add(NoteOnEvent(i % 200, i % 16, i % 128, 100));
+    }
+  ct5track.add(EndOfTrackEvent(0));
+  CompactTrack ct5(ct5track);
+  std::vector<std::uint8_t> ct5data = ct5.data();
+  if (ct5.count() != ct5track.event().size() || ct5data != ct5track.data()) pass = false;
+  std::vector<std::uint8_t> ct5out(ct5.size());
+  BufferSink ct5sink(&ct5out[0], ct5out.size());
+  if (!ct5.write(ct5sink) || ct5sink.used() != ct5out.size() || ct5out != ct5data) pass = false;
+  BufferSink ct5small(&ct5out[0], ct5out.size() - 1);
+  if (ct5.write(ct5small)) pass = false;
+  displayAndReset(pass, fail, "CT05");
+
+  //-----ARENA TESTS-----//
+  std::cout << std::endl << "--ARENA TESTS--" << std::endl;
+
+  //AR01: Allocation and release
+  EventArena ar1(64);
+  void* ar1a = ar1.allocate(3);
+  void* ar1b = ar1.allocate(100);
+  if (ar1a == NULL || ar1b == NULL || ar1a == ar1b) pass = false;
+  if (reinterpret_cast<std::uintptr_t>(ar1b) % EventArena::ALIGN != 0) pass = false;
+  if (ar1.used() < 103) pass = false;
+  std::uint8_t ar1bytes[] = {1, 2, 3};
+  std::uint8_t* ar1copy = ar1.copy(ar1bytes, 3);
+  if (ar1copy[0] != 1 || ar1copy[2] != 3) pass = false;
+  if (!ar1.owns(ar1a) || !ar1.owns(ar1copy + 2) || ar1.owns(ar1bytes)) pass = false;
+  ar1.release();
+  if (ar1.owns(ar1a)) pass = false;
+  if (ar1.used() != 0) pass = false;
+  displayAndReset(pass, fail, "AR01");
+
+  //AR02: EventTrack with events in an arena
+  std::shared_ptr<EventArena> ar2arena(new EventArena);
+  EventTrack ar2(ar2arena);
+  for (std::size_t i = 0; i < et4.event().size(); i++)
+    {
+      ar2.add(*et4.event()[i]);
+    }
+  ar2.adopt(new NoteOnEvent(0, 0, 60, 100));
+  if (ar2.arena() != ar2arena || ar2arena->used() == 0) pass = false;
+  if (ar2.event().size() != et4.event().size() + 1) pass = false;
+  Event* ar2placed = new (*ar2arena) NoteOffEvent(0, 0, 60, 0);
+  std::size_t ar2used = ar2arena->used();
+  ar2.adopt(ar2placed);
+  if (ar2.event().back() != ar2placed || ar2arena->used() != ar2used) pass = false;
+  if (ar2.event().size() != et4.event().size() + 2) pass = false;
+  std::vector<std::uint8_t> ar2data = ar2.data();
+  std::vector<std::uint8_t> ar2et4 = et4.data();
+  if (!std::equal(ar2et4.begin() + 8, ar2et4.end(), ar2data.begin() + 8)) pass = false;
+  Track* ar2clone = ar2.clone();
+  if (ar2clone->data() != ar2data) pass = false;
+  delete ar2clone;
+  ar2.clear();
+  if (ar2.event().size() != 0 || ar2.size() != 8) pass = false;
+  displayAndReset(pass, fail, "AR02");
+
+  //AR03: Type 1 MIDI sharing one arena between its tracks
+  MIDI_Type1 ar3(TimeDivision(96));
+  ar3.useArena();
+  ar3.addTrack(et4);
+  ar3.addTrack(nt4);
+  MIDI_Type1 ar3plain(TimeDivision(96));
+  ar3plain.addTrack(et4);
+  ar3plain.addTrack(nt4);
+  if (ar3.data() != ar3plain.data()) pass = false;
+  ar3.clear();
+  if (ar3.numTracks() != 0) pass = false;
+  displayAndReset(pass, fail, "AR03");
+
+  //AR04: Payloads of arena events live in the arena, and owns() over many blocks
+  std::shared_ptr<EventArena> ar4arena(new EventArena(64));
+  EventTrack ar4(ar4arena);
+  std::uint8_t ar4bytes[] = {'a', 'b', 'c', 'd', 'e'};
+  ar4.adopt(new (*ar4arena) RawMetaEvent(0, 0x01, Payload(ar4bytes, ar4bytes + 5)));
+  ar4.adopt(new (*ar4arena) RawSysExEvent(0, 0xF0, Payload(ar4bytes, ar4bytes + 5)));
+  ar4.add(MarkerEvent(10, "marker"));
+  ar4.add(NormalSysExEvent(0, std::vector<std::uint8_t>(3, 0x22)));
+  for (std::size_t i = 0; i < 40; i++)
+    {
+      ar4.adopt(new (*ar4arena) NoteOnEvent(1, 0, 60, 100));
+    }
+  ar4.add(EndOfTrackEvent(0));
+  Track* ar4copy = ar4.cloneInto(ar4arena);
+  const EventTrack & ar4copyEvents = *static_cast<EventTrack*>(ar4copy);
+  for (std::size_t i = 0; i < 4; i++)
+    {
+      const Event* ev = ar4.event()[i];
+      const Event* copy = ar4copyEvents.event()[i];
+      const Payload & p = i % 2 == 0 ? static_cast<const MetaEvent*>(ev)->payload() :
+        static_cast<const SysExEvent*>(ev)->payload();
+      const Payload & pc = i % 2 == 0 ? static_cast<const MetaEvent*>(copy)->payload() :
+        static_cast<const SysExEvent*>(copy)->payload();
+      if (!p.isView() || !ar4arena->owns(p.begin())) pass = false;
+      if (!pc.isView() || !ar4arena->owns(pc.begin()) || pc.begin() == p.begin()) pass = false;
+    }
+  for (std::size_t i = 0; i < ar4.event().size(); i++)
+    {
+      if (!ar4arena->owns(ar4.event()[i]) || !ar4arena->owns(ar4copyEvents.event()[i])) pass = false;
+    }
+  if (ar4arena->owns(ar4bytes) || ar4arena->owns(&ar4)) pass = false;
+  if (ar4copy->data() != ar4.data()) pass = false;
+  delete ar4copy;
+  displayAndReset(pass, fail, "AR04");
+
+  //-----TICK SCAN TESTS-----//
+  std::cout << std::endl << "--TICK SCAN TESTS--" << std::endl;
+
+  //TS01: Ticks match the events, with and without running status
+  EventTrack ts1 = nt7.toEvents();
+  for (int i = 0; i < 2; i++)
+    {
+      ts1.setRunningStatus(i == 1);
+      std::vector<std::uint8_t> ts1data = ts1.data();
+      std::vector<std::uint32_t> ts1ticks;
+      if (!scanTicks(&ts1data[8], &ts1data[0] + ts1data.size(), ts1ticks)) pass = false;
+      if (ts1ticks.size() != ts1.event().size()) pass = false;
+      else
+        {
+          std::uint32_t ts1time = 0;
+          for (std::size_t j = 0; j < ts1ticks.size(); j++)
+            {
+              ts1time += ts1.event()[j]->dt();
+              if (ts1ticks[j] != ts1time) pass = false;
+            }
+        }
+    }
+  displayAndReset(pass, fail, "TS01");
+
+  //TS02: Accumulation and malformed tracks
+  std::uint32_t ts2ticks[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+  accumulateTicks(ts2ticks, 9);
+  for (std::uint32_t i = 0; i < 9; i++)
+    {
+      if (ts2ticks[i] != (i+1)*(i+2)/2) pass = false;
+    }
+  std::vector<std::uint8_t> ts2data = et4.data();
+  std::vector<std::uint32_t> ts2out;
+  if (scanTicks(&ts2data[8], &ts2data[0] + ts2data.size() - 1, ts2out)) pass = false;
+  std::uint8_t ts2long[20] = {0x80, 0x80, 0x80, 0x80, 0x00, 0x90, 60, 100};
+  if (scanTicks(ts2long, ts2long + 20, ts2out)) pass = false;
+  displayAndReset(pass, fail, "TS02");
+
+  //TS03: Long tracks crossing many blocks, with every delta time length and
+  //meta and SysEx events landing at every offset
+  EventTrack ts3;
+  ts3.setRunningStatus(true);
+  std::uint32_t ts3dt[] = {0, 5, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF, 0x200000, 0x0FFFFFFF};
+  for (std::uint32_t i = 0; i < 3000; i++)
+    {
+      std::uint32_t dt = ts3dt[i % 9];
+      std::uint8_t channel = (i / 7) % 3;
+      if (i % 29 == 0) ts3.add(MarkerEvent(dt, std::string(i % 40, 'm')));
+      else if (i % 31 == 0) ts3.add(NormalSysExEvent(dt, std::vector<std::uint8_t>(i % 5 + 1, 0x11)));
+      else if (i % 11 == 0) ts3.add(ProgramChangeEvent(dt, channel, Instrument(i % 128)));
+      else if (i % 13 == 0) ts3.add(ChannelAftertouchEvent(dt, channel, i % 128));
+      else ts3.add(NoteOnEvent(dt, channel, i % 128, 100));
+    }
+  ts3.add(EndOfTrackEvent(0));
+  std::vector<std::uint8_t> ts3data = ts3.data();
+  std::vector<std::uint32_t> ts3ticks;
+  if (!scanTicks(&ts3data[8], &ts3data[0] + ts3data.size(), ts3ticks)) pass = false;
+  if (ts3ticks.size() != ts3.event().size()) pass = false;
+  else
+    {
+      std::uint32_t ts3time = 0;
+      for (std::size_t j = 0; j < ts3ticks.size(); j++)
+        {
+          ts3time += ts3.event()[j]->dt();
+          if (ts3ticks[j] != ts3time) pass = false;
+        }
+    }
+  std::vector<std::uint32_t> ts3sum(37);
+  for (std::uint32_t i = 0; i < 37; i++) ts3sum[i] = i + 1;
+  accumulateTicks(&ts3sum[0], 37);
+  for (std::uint32_t i = 0; i < 37; i++)
+    {
+      if (ts3sum[i] != (i+1)*(i+2)/2) pass = false;
+    }
+  displayAndReset(pass, fail, "TS03");
+
+  //-----TEMPO MAP TESTS-----//
+  std::cout << std::endl << "--TEMPO MAP TESTS--" << std::endl;
+
+  //TM01: Time division accessors
+  TimeDivision tm1a(96);
+  TimeDivision tm1b(29, 80);
+  if (tm1a.smpte() || tm1a.ppqn() != 96) pass = false;
+  if (!tm1b.smpte() || tm1b.fps() != 29 || tm1b.ticksPerFrame() != 80) pass = false;
+  displayAndReset(pass, fail, "TM01");
+
+  //TM02: Conversions with tempo changes
+  EventTrack tm2track;
+  tm2track.add(SetTempoEvent(192, 250000));
+  tm2track.add(NoteOnEvent(96, 0, 60, 100));
+  tm2track.add(SetTempoEvent(0, 1000000));
+  TempoMap tm2(tm2track, TimeDivision(96));
+  if (tm2.segments() != 3) pass = false;
+  if (tm2.microseconds(96) != 500000 || tm2.microseconds(192) != 1000000) pass = false;
+  if (tm2.microseconds(288) != 1250000 || tm2.microseconds(384) != 2250000) pass = false;
+  if (tm2.tick(1250000) != 288 || tm2.tick(2250000) != 384 || tm2.tick(1) != 0) pass = false;
+  std::uint32_t tm2ticks[] = {0, 1, 95, 191, 192, 287, 288, 289, 100000};
+  std::uint64_t tm2out[9];
+  tm2.microseconds(tm2ticks, 9, tm2out);
+  for (std::size_t i = 0; i < 9; i++)
+    {
+      if (tm2out[i] != tm2.microseconds(tm2ticks[i])) pass = false;
+      if (tm2.tick(tm2out[i]) != tm2ticks[i] && tm2ticks[i] % 96 == 0) pass = false;
+    }
+  tm2.setTempo(96, 250000);
+  if (tm2.microseconds(192) != 750000 || tm2.microseconds(288) != 1000000) pass = false;
+  displayAndReset(pass, fail, "TM02");
+
+  //TM03: SMPTE time divisions and whole MIDIs
+  TempoMap tm3a(TimeDivision(25, 40));
+  tm3a.setTempo(10, 1);
+  if (tm3a.microseconds(1000) != 1000000 || tm3a.tick(2000000) != 2000) pass = false;
+  TempoMap tm3b(TimeDivision(29, 100));
+  if (tm3b.microseconds(2997) != 1000000) pass = false;
+  MIDI_Type1 tm3mid(TimeDivision(96));
+  tm3mid.addTrack(nt9);
+  tm3mid.addTrack(CompactTrack(tm2track));
+  TempoMap tm3c(tm3mid);
+  if (tm3c.segments() != 3 || tm3c.microseconds(384) != 2250000) pass = false;
+  displayAndReset(pass, fail, "TM03");
+
+  //-----SEQUENCER TESTS-----//
+  std::cout << std::endl << "--SEQUENCER TESTS--" << std::endl;
+
+  //SQ01: Bounded queues fill up and empty in order
+  BoundedQueue<int, 4> sq1;
+  for (int i = 0; i < 4; i++)
+    {
+      if (!sq1.push(i)) pass = false;
+    }
+  int sq1val = -1;
+  if (sq1.push(4)) pass = false;
+  for (int i = 0; i < 4; i++)
+    {
+      if (!sq1.pop(sq1val) || sq1val != i) pass = false;
+    }
+  if (sq1.pop(sq1val)) pass = false;
+  displayAndReset(pass, fail, "SQ01");
+
+  //SQ02: Tracks are merged and played at the right times
+  //A quarter note is 10ms, and the song is one quarter note long
+  EventTrack sq2a;
+  sq2a.add(SetTempoEvent(0, 10000));
+  sq2a.add(NoteOnEvent(0, 0, 60, 100));
+  sq2a.add(NoteOffEvent(96, 0, 60, 0));
+  EventTrack sq2b;
+  sq2b.add(NoteOnEvent(48, 1, 64, 90));
+  sq2b.add(NoteOffEvent(48, 1, 64, 0));
+  MIDI_Type1 sq2mid(TimeDivision(96));
+  sq2mid.addTrack(sq2a);
+  sq2mid.addTrack(sq2b);
+  std::uint8_t sq2buf[64];
+  BufferSink sq2sink(sq2buf, 64);
+  std::chrono::steady_clock::time_point sq2start;
+  {
+    Sequencer sq2(sq2mid, sq2sink);
+    if (sq2.count() != 4 || sq2.length() != 10000) pass = false;
+    sq2start = std::chrono::steady_clock::now();
+    sq2.play();
+    for (int i = 0; i < 1000 && !sq2.finished(); i++)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    if (!sq2.finished() || sq2.sent() != 4 || sq2.position() != 10000) pass = false;
+  }
+  if (std::chrono::steady_clock::now() - sq2start < std::chrono::milliseconds(10)) pass = false;
+  std::uint8_t sq2expect[] = {0x90, 60, 100, 0x91, 64, 90, 0x80, 60, 0, 0x81, 64, 0};
+  if (sq2sink.used() != 12 || !std::equal(sq2expect, sq2expect + 12, sq2buf)) pass = false;
+  displayAndReset(pass, fail, "SQ02");
+
+  //SQ03: Seeking, slowing down, and silencing on pause
+  std::uint8_t sq3buf[64];
+  BufferSink sq3sink(sq3buf, 64);
+  std::chrono::steady_clock::time_point sq3start;
+  {
+    Sequencer sq3(sq2mid, sq3sink);
+    sq3.seek(96);
+    sq3.setTempoScale(0.5);
+    if (sq3.setTempoScale(0)) pass = false;
+    sq3start = std::chrono::steady_clock::now();
+    sq3.play();
+    for (int i = 0; i < 1000 && !sq3.finished(); i++)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    if (sq3.sent() != 2 || sq3sink.used() != 6 || sq3buf[0] != 0x80) pass = false;
+
+    sq3.seekTime(0);
+    sq3.setTempoScale(0.01);
+    sq3.play();
+    for (int i = 0; i < 1000 && sq3.sent() < 3; i++)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    sq3.pause();
+    for (int i = 0; i < 1000 && sq3.playing(); i++)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    if (sq3.playing() || sq3.finished() || sq3.position() >= 5000) pass = false;
+  }
+  if (sq3sink.used() != 12 || sq3buf[6] != 0x90 || sq3buf[9] != 0x80 || sq3buf[10] != 60)
+    pass = false;
+  displayAndReset(pass, fail, "SQ03");
+
+  //-----LIVE PARSER TESTS-----//
+  std::cout << std::endl << "--LIVE PARSER TESTS--" << std::endl;
+
+  //LP01: Running status with realtime bytes in the middle of messages
+  std::vector<std::vector<std::uint8_t> > lp1events;
+  std::vector<std::uint8_t> lp1system;
+  LiveParser lp1([&](const Event & ev, LiveParser::Clock::time_point)
+                 {lp1events.push_back(ev.data());});
+  lp1.setSystemCallback([&](const std::uint8_t* data, std::size_t size,
+                            LiveParser::Clock::time_point)
+                        {lp1system.insert(lp1system.end(), data, data + size);});
+  std::uint8_t lp1data[] = {0x90, 60, 0xF8, 100, 62, 0xFA, 90, 0xC3, 5, 6,
+                            0xF3, 2, 70, 0xE1, 0x10, 0xF8, 0x20};
+  lp1.feed(lp1data, sizeof(lp1data));
+  if (lp1events.size() != 5 || lp1.messages() != 9 || lp1.dropped() != 1) pass = false;
+  else
+    {
+      std::uint8_t lp1on[] = {0x00, 0x90, 62, 90};
+      std::uint8_t lp1bend[] = {0x00, 0xE1, 0x10, 0x20};
+      if (lp1events[1] != std::vector<std::uint8_t>(lp1on, lp1on + 4)) pass = false;
+      if (lp1events[2][2] != 5 || lp1events[3][1] != 0xC3 || lp1events[3][2] != 6 ||
+          lp1events[4] != std::vector<std::uint8_t>(lp1bend, lp1bend + 4))
+        pass = false;
+    }
+  std::uint8_t lp1sys[] = {0xF8, 0xFA, 0xF3, 2, 0xF8};
+  if (lp1system != std::vector<std::uint8_t>(lp1sys, lp1sys + 5)) pass = false;
+  displayAndReset(pass, fail, "LP01");
+
+  //LP02: SysEx spanning several reads, cut off, and too long
+  std::vector<std::vector<std::uint8_t> > lp2sysex;
+  LiveParser lp2([&](const Event & ev, LiveParser::Clock::time_point)
+                 {
+                   const SysExEvent* sx = dynamic_cast<const SysExEvent*>(&ev);
+                   if (sx != NULL) lp2sysex.push_back(sx->payload());
+                 }, 4);
+  std::uint8_t lp2a[] = {0x80, 60, 0, 0xF0, 1, 2};
+  std::uint8_t lp2b[] = {0xF8, 3, 0xF7, 0xF0, 1, 0x90, 60, 1};
+  std::uint8_t lp2c[] = {0xF0, 1, 2, 3, 4, 5, 0xF7, 0xF7};
+  lp2.feed(lp2a, sizeof(lp2a));
+  lp2.feed(lp2b, sizeof(lp2b));
+  lp2.feed(lp2c, sizeof(lp2c));
+  std::uint8_t lp2expect[] = {1, 2, 3, 0xF7};
+  if (lp2sysex.size() != 1 || lp2sysex[0] != std::vector<std::uint8_t>(lp2expect, lp2expect + 4))
+    pass = false;
+  if (lp2.messages() != 4 || lp2.dropped() != 3) pass = false;
+  displayAndReset(pass, fail, "LP02");
+
+  //LP03: Reading from a pipe, with timestamps in order
+#if defined(__unix__) || defined(__APPLE__)
+  int lp3pipe[2];
+  std::vector<LiveParser::Clock::time_point> lp3times;
+  LiveParser lp3([&](const Event &, LiveParser::Clock::time_point time)
+                 {lp3times.push_back(time);});
+  LiveParser::Clock::time_point lp3start = LiveParser::Clock::now();
+  if (pipe(lp3pipe) != 0) pass = false;
+  else
+    {
+      std::uint8_t lp3a[] = {0xB0, 7, 100, 10};
+      std::uint8_t lp3b[] = {0x20, 11, 0x30};
+      if (write(lp3pipe[1], lp3a, 4) != 4) pass = false;
+      if (lp3.readFrom(lp3pipe[0]) != 4) pass = false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      if (write(lp3pipe[1], lp3b, 3) != 3) pass = false;
+      close(lp3pipe[1]);
+      if (lp3.readFrom(lp3pipe[0]) != 3 || lp3.readFrom(lp3pipe[0]) != 0) pass = false;
+      close(lp3pipe[0]);
+    }
+  //Messages are timed by their first byte
+  if (lp3times.size() != 3 || lp3times[0] < lp3start || lp3times[1] != lp3times[0] ||
+      lp3times[2] <= lp3times[1])
+    pass = false;
+#endif
+  displayAndReset(pass, fail, "LP03");
+
+  //-----THREAD POOL TESTS-----//
+  std::cout << std::endl << "--THREAD POOL TESTS--" << std::endl;
+
+  //TP01: Submitted tasks and nested loops all run
+  std::atomic<std::size_t> tp1count(0);
+  {
+    ThreadPool tp1(3);
+    if (tp1.size() != 3) pass = false;
+    for (std::size_t i = 0; i < 100; i++)
+      {
+        tp1.submit([&]() {tp1count++;});
+      }
+    tp1.wait();
+    if (tp1count != 100) pass = false;
+
+    std::vector<std::size_t> tp1sums(20, 0);
+    tp1.parallelFor(20, [&](std::size_t i)
+                    {
+                      std::atomic<std::size_t> sum(0);
+                      tp1.parallelFor(i, [&](std::size_t j) {sum += j + 1;});
+                      tp1sums[i] = sum;
+                    });
+    for (std::size_t i = 0; i < 20; i++)
+      {
+        if (tp1sums[i] != i * (i + 1) / 2) pass = false;
+      }
+    tp1.submit([&]() {tp1count++;});
+  }
+  if (tp1count != 101) pass = false;
+  ThreadPool tp1default;
+  if (tp1default.size() == 0) pass = false;
+  displayAndReset(pass, fail, "TP01");
+
+  //TP02: Idle workers steal tasks queued behind a busy one
+  {
+    ThreadPool tp2(2);
+    std::atomic<bool> tp2done(false);
+    std::thread::id tp2outer, tp2inner;
+    tp2.submit([&]()
+               {
+                 tp2outer = std::this_thread::get_id();
+                 tp2.submit([&]()
+                            {
+                              tp2inner = std::this_thread::get_id();
+                              tp2done = true;
+                            });
+                 //The inner task sits on this worker's queue until stolen
+                 std::chrono::steady_clock::time_point limit =
+                   std::chrono::steady_clock::now() + std::chrono::seconds(5);
+                 while (!tp2done && std::chrono::steady_clock::now() < limit)
+                   std::this_thread::yield();
+               });
+    tp2.wait();
+    if (!tp2done || tp2inner == tp2outer) pass = false;
+
+    //Tasks submitted from several threads at once are all counted
+    std::atomic<std::size_t> tp2count(0);
+    std::vector<std::thread> tp2threads;
+    for (std::size_t i = 0; i < 4; i++)
+      {
+        tp2threads.push_back(std::thread([&]()
+                                         {
+                                           for (std::size_t j = 0; j < 500; j++)
+                                             tp2.submit([&]() {tp2count++;});
+                                         }));
+      }
+    for (std::size_t i = 0; i < tp2threads.size(); i++)
+      {
+        tp2threads[i].join();
+      }
+    tp2.wait();
+    if (tp2count != 2000) pass = false;
+  }
+  displayAndReset(pass, fail, "TP02");
+
+  //-----NOTE CACHE TESTS-----//
+  std::cout << std::endl << "--NOTE CACHE TESTS--" << std::endl;
+
+  //NK01: Notes are split into columns and everything else is kept aside
+  EventTrack nk1track;
+  nk1track.add(SetTempoEvent(0, 400000));
+  nk1track.add(ProgramChangeEvent(0, 2, Instrument::VIOLIN));
+  nk1track.add(NoteOnEvent(0, 2, 60, 90));
+  nk1track.add(ControllerEvent(5, 2, 7, 100));
+  nk1track.add(NoteOnEvent(5, 3, 64, 80));
+  nk1track.add(NoteOffEvent(10, 2, 60, 33));
+  nk1track.add(NoteOnEvent(0, 3, 64, 0));
+  nk1track.add(NoteOffEvent(0, 4, 70, 0));
+  nk1track.add(NoteOnEvent(0, 5, 72, 50));
+  nk1track.add(NormalSysExEvent(3, std::vector<std::uint8_t>(3, 0x11)));
+  nk1track.add(EndOfTrackEvent(0));
+  MIDI_Type1 nk1mid(TimeDivision(96));
+  nk1mid.addTrack(nk1track);
+  nk1mid.addTrack(nt9);
+  std::vector<std::uint8_t> nk1data = NoteCache::encode(nk1mid);
+  NoteCache nk1(&nk1data[0], nk1data.size());
+  if (!nk1.valid() || nk1.type() != 1 || nk1.numTracks() != 2) pass = false;
+  else
+    {
+      if (nk1.notes(0) != 2 || nk1.notes(1) != nt9.note().size()) pass = false;
+      if (nk1.begin(0)[0] != 0 || nk1.duration(0)[0] != 20 || nk1.begin(0)[1] != 10) pass = false;
+      if (nk1.duration(0)[1] != 10 || nk1.pitch(0)[1] != 64 || nk1.velocity(0)[0] != 90) pass = false;
+      if (nk1.release(0)[0] != 33 || nk1.release(0)[1] != 0xFF || nk1.channel(0)[1] != 3) pass = false;
+      if (nk1.instrument(0)[0] != std::uint8_t(Instrument::VIOLIN) || nk1.instrument(0)[1] != 0)
+        pass = false;
+      if ((reinterpret_cast<const std::uint8_t*>(nk1.duration(0)) - &nk1data[0]) % 64 != 0) pass = false;
+      if (nk1.meta(0).count() != 2 || nk1.events(0).count() != 5) pass = false;
+      NoteTrack nk1notes = nk1.toNotes(1);
+      if (nk1notes.note().size() != 5 || nk1notes.note()[4].begin != 70000) pass = false;
+      else if (nk1notes.note()[4].instrument != Instrument::VIOLIN ||
+               nk1notes.note()[1].duration != 0 || nk1notes.note()[0].duration != 10)
+        pass = false;
+    }
+  displayAndReset(pass, fail, "NK01");
+
+  //NK02: Converting back keeps every event, and converting again is exact
+  MIDI* nk2 = nk1.toMIDI();
+  if (nk2 == NULL || nk2->numTracks() != 2) pass = false;
+  else
+    {
+      if (NoteCache::encode(*nk2) != nk1data) pass = false;
+      if (nk2->track(0).size() != nk1track.size()) pass = false;
+      if (nk2->track(0).data() != nk1track.data()) pass = false;
+    }
+  freeLoadedMIDI(nk2);
+  std::vector<std::uint8_t> nk2md11 = NoteCache::encode(md11);
+  NoteCache nk2cache(&nk2md11[0], nk2md11.size());
+  if (static_cast<const EventTrack&>(md11.track(0)).toNotes().note().size() != nk2cache.notes(0))
+    pass = false;
+  displayAndReset(pass, fail, "NK02");
+
+  //NK03: Mapping cache files, and rejecting damaged ones
+  if (!NoteCache::write(md11, "test.midc")) pass = false;
+  NoteCache nk3("test.midc");
+  if (!nk3.valid() || nk3.numTracks() != 40 || nk3.notes(1) != nt9.note().size()) pass = false;
+  MIDI* nk3mid = nk3.toMIDI();
+  if (nk3mid == NULL || NoteCache::encode(*nk3mid) != nk2md11) pass = false;
+  freeLoadedMIDI(nk3mid);
+  std::vector<std::uint8_t> nk3bad(nk1data);
+  nk3bad.pop_back();
+  if (NoteCache(&nk3bad[0], nk3bad.size()).valid()) pass = false;
+  nk3bad = nk1data;
+  nk3bad[64 + 8] = 0xFF;
+  if (NoteCache(&nk3bad[0], nk3bad.size()).valid()) pass = false;
+  if (NoteCache("does_not_exist.midc").valid() || NoteCache("test.mid").valid()) pass = false;
+
+  //A garbled section is caught when it's decoded
+  nk3bad = nk1data;
+  std::size_t nk3events = 0;
+  for (std::size_t i = 0, found = 0; i + 4 <= nk3bad.size() && found < 2; i++)
+    {
+      if (std::equal(nk3bad.begin() + i, nk3bad.begin() + i + 4, "MTrk") && ++found == 2)
+        nk3events = i;
+    }
+  if (nk3events == 0) pass = false;
+  else
+    {
+      std::fill(nk3bad.begin() + nk3events + 8, nk3bad.begin() + nk3events + 13, 0x80);
+      NoteCache nk3garbled(&nk3bad[0], nk3bad.size());
+      if (!nk3garbled.valid() || nk3garbled.events(0).count() != 0) pass = false;
+      if (nk3garbled.meta(0).count() != 2 || nk3garbled.toMIDI() != NULL) pass = false;
+    }
+  displayAndReset(pass, fail, "NK03");
+
+  //NK04: Events keep their place among the notes of their tick
+  EventTrack nk4track;
+  nk4track.add(NoteOnEvent(0, 0, 60, 90));
+  nk4track.add(ProgramChangeEvent(0, 0, Instrument::VIOLIN));
+  nk4track.add(NoteOnEvent(0, 0, 64, 90));
+  nk4track.add(ControllerEvent(0, 0, 7, 100));
+  nk4track.add(NoteOffEvent(10, 0, 64, 0));
+  nk4track.add(MarkerEvent(0, "between"));
+  nk4track.add(NoteOnEvent(0, 0, 67, 90));
+  nk4track.add(NoteOffEvent(0, 0, 67, 0));
+  nk4track.add(NoteOffEvent(0, 0, 60, 0));
+  nk4track.add(EndOfTrackEvent(0));
+  MIDI_Type0 nk4mid(nk4track, TimeDivision(96));
+  std::vector<std::uint8_t> nk4data = NoteCache::encode(nk4mid);
+  NoteCache nk4(&nk4data[0], nk4data.size());
+  if (!nk4.valid() || nk4.notes(0) != 3) pass = false;
+  else if (nk4.onOrder(0)[1] != 2 || nk4.offOrder(0)[1] != 0) pass = false;
+  MIDI* nk4back = nk4.toMIDI();
+  if (nk4back == NULL || nk4back->track(0).data() != nk4track.data()) pass = false;
+  freeLoadedMIDI(nk4back);
+  displayAndReset(pass, fail, "NK04");
+
+  //-----VALIDATOR TESTS-----//
+  std::cout << std::endl << "--VALIDATOR TESTS--" << std::endl;
+
+  //VA01: A well-formed file, with running status, meta, SysEx, and an
+  //unknown chunk, passes
+  std::uint8_t va1good[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 2, 0, 96,
+                            'X', 'Y', 'Z', 'W', 0, 0, 0, 2, 0xF1, 0xF2,
+                            'M', 'T', 'r', 'k', 0, 0, 0, 23,
+                            0x00, 0x90, 60, 100,
+                            0x81, 0x00, 60, 0,
+                            0x00, 0xFF, 0x51, 3, 7, 0xA1, 0x20,
+                            0x00, 0xF0, 1, 0xF7,
+                            0x00, 0xFF, 0x2F, 0,
+                            'M', 'T', 'r', 'k', 0, 0, 0, 4, 0x00, 0xFF, 0x2F, 0};
+  std::vector<std::uint8_t> va1(va1good, va1good + sizeof(va1good));
+  if (!validate(&va1[0], va1.size()).ok()) pass = false;
+  if (validate(&va1[0], va1.size()).describe() != std::string("valid")) pass = false;
+  displayAndReset(pass, fail, "VA01");
+
+  //VA02: Each kind of damage is found at the right place
+  struct VA2Case
+  {
+    std::size_t index;
+    std::uint8_t value;
+    ValidationError::Code code;
+    std::size_t offset;
+    std::size_t track;
+  };
+  VA2Case va2cases[] = {
+    {0, 'X', ValidationError::BAD_HEADER_ID, 0, 0},
+    {7, 5, ValidationError::BAD_HEADER_LENGTH, 4, 0},
+    {6, 1, ValidationError::BAD_HEADER_LENGTH, 4, 0},
+    {9, 3, ValidationError::BAD_FORMAT, 8, 0},
+    {9, 0, ValidationError::BAD_TRACK_COUNT, 10, 0},
+    {12, 0xE6, ValidationError::BAD_TIME_DIVISION, 12, 0},
+    {21, 200, ValidationError::CHUNK_OVERRUN, 18, 0},
+    {31, 200, ValidationError::CHUNK_OVERRUN, 28, 0},
+    {31, 3, ValidationError::TRUNCATED_EVENT, 33, 0},
+    {33, 60, ValidationError::NO_RUNNING_STATUS, 33, 0},
+    {33, 0xF1, ValidationError::ILLEGAL_STATUS, 33, 0},
+    {35, 0x80, ValidationError::BAD_DATA_BYTE, 35, 0},
+    {42, 0xAF, ValidationError::BAD_META_TYPE, 42, 0},
+    {43, 0x85, ValidationError::TRUNCATED_EVENT, 41, 0},
+    {53, 0x01, ValidationError::MISSING_END_OF_TRACK, 55, 0},
+    {62, 5, ValidationError::CHUNK_OVERRUN, 59, 1}
+  };
+  for (std::size_t i = 0; i < sizeof(va2cases) / sizeof(VA2Case); i++)
+    {
+      std::vector<std::uint8_t> va2(va1);
+      va2[va2cases[i].index] = va2cases[i].value;
+      ValidationError err = validate(&va2[0], va2.size());
+      if (err.code != va2cases[i].code || err.offset != va2cases[i].offset ||
+          err.track != va2cases[i].track)
+        pass = false;
+    }
+  std::vector<std::uint8_t> va2more(va1);
+  va2more.insert(va2more.begin() + 55, va1good + 63, va1good + 67);
+  va2more[31] += 4;
+  ValidationError va2err = validate(&va2more[0], va2more.size());
+  if (va2err.code != ValidationError::EVENTS_AFTER_END || va2err.offset != 55) pass = false;
+  va2more = va1;
+  va2more[54] = 1;
+  va2more.insert(va2more.begin() + 55, 0);
+  va2more[31] += 1;
+  va2err = validate(&va2more[0], va2more.size());
+  if (va2err.code != ValidationError::BAD_END_OF_TRACK || va2err.offset != 54) pass = false;
+  va2more = va1;
+  std::fill(va2more.begin() + 32, va2more.begin() + 36, 0x80);
+  va2err = validate(&va2more[0], va2more.size());
+  if (va2err.code != ValidationError::VARLENGTH_TOO_LONG || va2err.offset != 35) pass = false;
+  if (validate(&va1[0], 13).code != ValidationError::TRUNCATED_HEADER) pass = false;
+  if (validate(&va1[0], 55).code != ValidationError::MISSING_TRACKS) pass = false;
+  if (validate(&va1[0], 60).code != ValidationError::TRUNCATED_CHUNK) pass = false;
+  displayAndReset(pass, fail, "VA02");
+
+  //VA03: Files on disk, and agreement with load
+  std::ofstream va3out("valid.mid", std::ios_base::out | std::ios_base::trunc |
+                       std::ios_base::binary);
+  va3out.write((const char*)(&va1[0]), va1.size());
+  va3out.close();
+  if (!validate("valid.mid").ok()) pass = false;
+  MIDI* va3 = load("valid.mid");
+  if (va3 == NULL || va3->numTracks() != 2) pass = false;
+  freeLoadedMIDI(va3);
+  va3out.open("truncated.mid", std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+  va3out.write((const char*)(&va1[0]), va1.size() - 2);
+  va3out.close();
+  if (validate("truncated.mid").code != ValidationError::CHUNK_OVERRUN) pass = false;
+  if (validate("does_not_exist.mid").code != ValidationError::UNREADABLE) pass = false;
+  displayAndReset(pass, fail, "VA03");
+
+  //-----LOAD TESTS-----//
+  std::cout << std::endl << "--LOAD TESTS--" << std::endl;
+
+  //LD01: Type 1 round trip
+  MIDI* ld1 = load("test2.mid");
+  if (ld1 == NULL) pass = false;
+  else
+    {
+      if (ld1->numTracks() != 2) pass = false;
+      if (ld1->size() != md5.size()) pass = false;
+      if (ld1->data() != md5.data()) pass = false;
+      if (dynamic_cast<MIDI_Type1*>(ld1) == NULL) pass = false;
+    }
+  displayAndReset(pass, fail, "LD01");
+
+  //LD02: Loaded meta event payloads refer into the file
+  if (ld1 != NULL)
+    {
+      const EventTrack* ld2 = dynamic_cast<const EventTrack*>(&ld1->track(1));
+      if (ld2 == NULL || ld2->event().size() != 5) pass = false;
+      else
+        {
+          const MetaEvent* ld2a = dynamic_cast<const MetaEvent*>(ld2->event()[0]);
+          if (ld2a == NULL || !ld2a->payload().isView()) pass = false;
+          if (ld2a != NULL && ld2a->metaType() != 0x58) pass = false;
+          Event* ld2b = ld2->event()[0]->clone();
+          if (static_cast<MetaEvent*>(ld2b)->payload().isView()) pass = false;
+          delete ld2b;
+          if (ld2->event()[3]->dt() != 40000) pass = false;
+        }
+      freeLoadedMIDI(ld1);
+    }
+  displayAndReset(pass, fail, "LD02");
+
+  //LD03: Type 0 round trip with SMPTE time division
+  MIDI* ld3 = load("test4.mid");
+  if (ld3 == NULL) pass = false;
+  else
+    {
+      if (dynamic_cast<MIDI_Type0*>(ld3) == NULL) pass = false;
+      if (ld3->data() != md7.data()) pass = false;
+      if (ld3->timeDivision().data() != TimeDivision(26, 20).data()) pass = false;
+      freeLoadedMIDI(ld3);
+    }
+  displayAndReset(pass, fail, "LD03");
+
+  //LD04: Missing and truncated files fail to load
+  if (load("does_not_exist.mid") != NULL) pass = false;
+  std::vector<std::uint8_t> ld4data = md5.data();
+  std::ofstream ld4out("truncated.mid", std::ios_base::out | std::ios_base::trunc |
+                       std::ios_base::binary);
+  ld4out.write((const char*)(&ld4data[0]), ld4data.size() - 5);
+  ld4out.close();
+  if (load("truncated.mid") != NULL) pass = false;
+  displayAndReset(pass, fail, "LD04");
+
+  //LD05: Decoding tracks on a thread pool keeps their order
+  if (!md11.write("test5.mid")) pass = false;
+  MIDI* ld5 = load("test5.mid", md11pool);
+  MIDI* ld5serial = load("test5.mid");
+  if (ld5 == NULL || ld5serial == NULL) pass = false;
+  else
+    {
+      if (ld5->numTracks() != 40 || ld5->data() != ld5serial->data()) pass = false;
+      if (ld5->track(2).data() != CompactTrack(et4).data()) pass = false;
+    }
+  freeLoadedMIDI(ld5);
+  freeLoadedMIDI(ld5serial);
+  MIDI* ld5test3 = load("test3.mid", md11pool);
+  if (ld5test3 == NULL || ld5test3->data() != md6.data()) pass = false;
+  freeLoadedMIDI(ld5test3);
+  if (load("truncated.mid", md11pool) != NULL) pass = false;
+  displayAndReset(pass, fail, "LD05");
+
+  //LD06: Pitch bends survive loading, cloning and normalizing
+  std::uint8_t ld6bytes[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+                             'M', 'T', 'r', 'k', 0, 0, 0, 12,
+                             0x00, 0xE0, 0x00, 0x40,
+                             0x10, 0xE3, 0x7F, 0x12,
+                             0x00, 0xFF, 0x2F, 0x00};
+  std::vector<std::uint8_t> ld6file(ld6bytes, ld6bytes + sizeof(ld6bytes));
+  std::ofstream ld6out("bend.mid", std::ios_base::out | std::ios_base::trunc |
+                       std::ios_base::binary);
+  ld6out.write((const char*)(ld6bytes), sizeof(ld6bytes));
+  ld6out.close();
+  MIDI* ld6 = load("bend.mid");
+  if (ld6 == NULL) pass = false;
+  else
+    {
+      const EventTrack & ld6track = static_cast<const EventTrack&>(ld6->track(0));
+      std::vector<std::uint8_t> ld6expected(ld6file.begin() + 14, ld6file.end());
+      Event* ld6clone = ld6track.event()[0]->clone();
+      std::vector<std::uint8_t> ld6ev;
+      ld6clone->encodeInto(ld6ev);
+      if (ld6ev != std::vector<std::uint8_t>(ld6bytes + 22, ld6bytes + 26)) pass = false;
+      delete ld6clone;
+      if (EventTrack(ld6track).data() != ld6expected) pass = false;
+      if (ld6track.normalized().data() != ld6expected) pass = false;
+      if (MIDI_Type0(ld6track, TimeDivision(96)).data() != ld6file) pass = false;
+      std::shared_ptr<EventArena> ld6arena(new EventArena);
+      std::unique_ptr<Track> ld6arenaTrack(ld6track.cloneInto(ld6arena));
+      if (ld6arenaTrack->data() != ld6expected) pass = false;
+    }
+  freeLoadedMIDI(ld6);
+  displayAndReset(pass, fail, "LD06");
+
+  //-----STREAM PARSER TESTS-----//
+  std::cout << std::endl << "--STREAM PARSER TESTS--" << std::endl;
+
+  //SP01: Byte-at-a-time and odd-sized pieces rebuild the same file
+  std::vector<std::uint8_t> sp1data = md5.data();
+  std::size_t sp1pieces[] = {1, 7, 4096};
+  for (int piece = 0; piece < 3; piece++)
+    {
+      StreamCollector sp1;
+      StreamParser sp1p(std::ref(sp1));
+      for (std::size_t i = 0; i < sp1data.size(); i += sp1pieces[piece])
+        {
+          std::size_t len = std::min(sp1pieces[piece], sp1data.size() - i);
+          if (!sp1p.feed(&sp1data[i], len)) pass = false;
+        }
+      if (sp1p.type() != 1 || sp1p.numTracks() != 2) pass = false;
+      if (sp1.tracks.size() != 2) pass = false;
+      else
+        {
+          MIDI_Type1 sp1m(TimeDivision(25,120));
+          sp1m.addTrack(sp1.tracks[0]);
+          sp1m.addTrack(sp1.tracks[1]);
+          if (sp1m.data() != sp1data) pass = false;
+        }
+    }
+  displayAndReset(pass, fail, "SP01");
+
+  //SP02: Concatenated files
+  StreamCollector sp2;
+  StreamParser sp2p(std::ref(sp2));
+  sp2p.feed(&sp1data[0], sp1data.size());
+  sp2p.feed(&sp1data[0], sp1data.size());
+  if (sp2p.failed() || sp2p.filesStarted() != 2) pass = false;
+  if (sp2.tracks.size() != 2 || sp2.tracks[1].event().size() != 10) pass = false;
+  displayAndReset(pass, fail, "SP02");
+
+  //SP03: Invalid input is reported
+  StreamCollector sp3;
+  StreamParser sp3p(std::ref(sp3));
+  std::uint8_t sp3data[] = {'M', 'T', 'r', 'k', 0, 0, 0, 3, 0x00, 0xF4, 0x00};
+  if (sp3p.feed(sp3data, sizeof(sp3data))) pass = false;
+  if (!sp3p.failed()) pass = false;
+  sp3p.reset();
+  if (sp3p.failed()) pass = false;
+  displayAndReset(pass, fail, "SP03");
+
   //-----SCALE TESTS-----//
   std::cout << std::endl << "--SCALE TESTS--" << std::endl;
 
@@ -664,6 +2027,22 @@ int main()
   if (harMinorScale("A3",8) != "A4") pass = false;
   displayAndReset(pass, fail, "SC05");
 
+  //SC06: Modes and compile time scales
+  static_assert(majorScale("C3", 8) == "C4"_note && majorScale("C3", 0) == "B2"_note, "SC06");
+  static_assert(scaleNote(DORIAN_MODE, "D3"_note, 3) == "F3"_note, "SC06");
+  static_assert(scaleNote(LYDIAN_MODE, "F3"_note, 4) == "B3"_note, "SC06");
+  static_assert(scaleNote(LOCRIAN_MODE, "B3"_note, -5) == "C3"_note, "SC06");
+  for (int i = 1; i <= 14; i++)
+    {
+      if (scaleNote(AEOLIAN_MODE, "A3", i) != natMinorScale("A3", i)) pass = false;
+      if (scaleNote(MIXOLYDIAN_MODE, "G3", i) != majorScale("C3", i+4)) pass = false;
+      if (scaleNote(PHRYGIAN_MODE, "E3", i) != majorScale("C3", i+2)) pass = false;
+    }
+  if (scaleTriad(MAJOR_SCALE, "C4", 5) != majTriad("G4")) pass = false;
+  if (scaleSeventh(MAJOR_SCALE, "C4", 5) != domSeventh("G4")) pass = false;
+  if (scaleTriad(HAR_MINOR_SCALE, "A3", 7) != dimTriad("G#4")) pass = false;
+  displayAndReset(pass, fail, "SC06");
+
   //-----CHORD TESTS-----//
   std::cout << std::endl << "--CHORD TESTS--" << std::endl;
 
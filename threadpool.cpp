@@ -0,0 +1,195 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----ThreadPool Class Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation for the ThreadPool class, a fixed set of worker
+  threads that independent pieces of work can be spread over.
+*/
+
+#include "threadpool.hpp"
+
+namespace midi
+{
+
+  //The pool and queue of the worker running on this thread, if any
+  static thread_local const ThreadPool* currentPool = NULL;
+  static thread_local std::size_t currentWorker = 0;
+
+  //Shared by the caller and helpers of one parallelFor. Helpers which start
+  //after the caller has finished do nothing, so the caller never waits on a
+  //task still stuck in the queue.
+  struct ParallelFor
+  {
+    ParallelFor(std::size_t c, const std::function<void(std::size_t)> & t) :
+      next(0), count(c), task(t), running(0), closed(false) {}
+
+    //Runs items until none are left
+    void run()
+    {
+      std::size_t i;
+      while ((i = next.fetch_add(1)) < count) task(i);
+    }
+
+    std::atomic<std::size_t> next;
+    std::size_t count;
+    const std::function<void(std::size_t)> & task;
+
+    std::mutex mutex;
+    std::condition_variable done;
+    std::size_t running;
+    bool closed;
+  };
+
+  //Constructor, starts the workers
+  ThreadPool::ThreadPool(std::size_t threads) :
+    nextQueue_(0), queued_(0), active_(0), stop_(false)
+  {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    queue_.reserve(threads);
+    for (std::size_t i = 0; i < threads; i++)
+      {
+        queue_.push_back(std::unique_ptr<Queue>(new Queue));
+      }
+    worker_.reserve(threads);
+    for (std::size_t i = 0; i < threads; i++)
+      {
+        worker_.push_back(std::thread(&ThreadPool::work, this, i));
+      }
+  }
+
+  //Destructor, finishes the queues and joins the workers
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    ready_.notify_all();
+    for (std::size_t i = 0; i < worker_.size(); i++)
+      {
+        worker_[i].join();
+      }
+  }
+
+  //Queues a task on the current worker, or the next one in turn
+  void ThreadPool::submit(std::function<void()> task)
+  {
+    std::size_t index;
+    if (currentPool == this) index = currentWorker;
+    else index = nextQueue_.fetch_add(1) % queue_.size();
+
+    //The count goes up before the task can be taken, so it never runs below
+    //zero. The queue lock is only ever taken inside the count lock, not the
+    //other way around.
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queued_++;
+      std::lock_guard<std::mutex> queueLock(queue_[index]->mutex);
+      queue_[index]->task.push_back(std::move(task));
+    }
+    ready_.notify_one();
+  }
+
+  //Splits count items between the caller and up to one helper per worker
+  void ThreadPool::parallelFor(std::size_t count,
+                               const std::function<void(std::size_t)> & task)
+  {
+    if (count == 0) return;
+    std::shared_ptr<ParallelFor> state(new ParallelFor(count, task));
+
+    std::size_t helpers = count - 1;
+    if (helpers > worker_.size()) helpers = worker_.size();
+    for (std::size_t i = 0; i < helpers; i++)
+      {
+        submit([state]()
+               {
+                 {
+                   std::lock_guard<std::mutex> lock(state->mutex);
+                   if (state->closed) return;
+                   state->running++;
+                 }
+                 state->run();
+                 std::lock_guard<std::mutex> lock(state->mutex);
+                 if (--state->running == 0) state->done.notify_all();
+               });
+      }
+
+    state->run();
+
+    //Every item has been taken, but helpers may still be working on theirs
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->closed = true;
+    while (state->running > 0) state->done.wait(lock);
+  }
+
+  //Waits for the queues to empty and the workers to go idle
+  void ThreadPool::wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (queued_ > 0 || active_ > 0) idle_.wait(lock);
+  }
+
+  //Takes the newest task of a worker's own queue, or the oldest of another's
+  bool ThreadPool::take(std::size_t index, std::function<void()> & task)
+  {
+    bool found = false;
+    {
+      Queue & own = *queue_[index];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.task.empty())
+        {
+          task = std::move(own.task.back());
+          own.task.pop_back();
+          found = true;
+        }
+    }
+    for (std::size_t i = 1; i < queue_.size() && !found; i++)
+      {
+        Queue & other = *queue_[(index + i) % queue_.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.task.empty())
+          {
+            task = std::move(other.task.front());
+            other.task.pop_front();
+            found = true;
+          }
+      }
+    if (!found) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_--;
+    active_++;
+    return true;
+  }
+
+  //Takes tasks until told to stop and nothing is left
+  void ThreadPool::work(std::size_t index)
+  {
+    currentPool = this;
+    currentWorker = index;
+
+    std::function<void()> task;
+    for (;;)
+      {
+        if (take(index, task))
+          {
+            task();
+            task = nullptr;
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_--;
+            if (queued_ == 0 && active_ == 0) idle_.notify_all();
+            continue;
+          }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (queued_ == 0 && !stop_) ready_.wait(lock);
+        if (queued_ == 0) return;
+      }
+  }
+
+} //Namespace
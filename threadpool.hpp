@@ -0,0 +1,88 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----ThreadPool Class Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the ThreadPool class, a fixed set of worker threads
+  that independent pieces of work can be spread over.
+*/
+
+#ifndef _threadpool_hpp_
+#define _threadpool_hpp_
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+
+namespace midi
+{
+
+  //Each worker has its own queue. Tasks submitted from a worker go on its
+  //own queue and are taken newest first, while idle workers steal the oldest
+  //tasks of the others, so nested work stays local until someone is free.
+  class ThreadPool
+  {
+  public:
+    //Starts the workers. 0 starts one per core.
+    ThreadPool(std::size_t threads = 0);
+
+    //Finishes every task already submitted, then stops the workers
+    ~ThreadPool();
+
+    std::size_t size() const {return worker_.size();}
+
+    //Runs a task on some worker
+    //From outside the pool, tasks are dealt to the workers in turn
+    void submit(std::function<void()> task);
+
+    //Runs task(i) for every i below count and returns once all are done.
+    //The calling thread takes part, so this can be called from a task.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)> & task);
+
+    //Waits until every task submitted so far has finished
+    void wait();
+
+  private:
+    //Pools own their threads and can't be copied
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    struct Queue
+    {
+      std::mutex mutex;
+      std::deque<std::function<void()> > task;
+    };
+
+    //Worker thread loop
+    void work(std::size_t index);
+
+    //Takes a task from a worker's own queue, or else steals one
+    bool take(std::size_t index, std::function<void()> & task);
+
+    std::vector<std::thread> worker_;
+    std::vector<std::unique_ptr<Queue> > queue_;
+    std::atomic<std::size_t> nextQueue_;
+
+    //Guards the counts, which workers sleep on
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable idle_;
+
+    //Tasks queued but not taken, and taken but not finished
+    std::size_t queued_;
+    std::size_t active_;
+    bool stop_;
+  };
+
+} //Namespace
+
+#endif
@@ -0,0 +1,275 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Tick Scanning Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains functions to find the absolute time of every event in raw track data
+  without building the events. With SSE2, the high bits of each 16 byte block
+  are found with one load and the events in it are stepped over using only that
+  mask. With AVX2, found at run time, the blocks are 32 bytes and the prefix sum
+  is eight wide. Other targets use a byte at a time walk.
+*/
+
+#include "tickscan.hpp"
+#include "varlength.hpp"
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#define MIDI_TICKSCAN_SSE2
+#include <emmintrin.h>
+#if defined(__x86_64__) || defined(__i386__)
+#define MIDI_TICKSCAN_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace midi
+{
+
+  //Number of parameter bytes following a channel status byte
+  static std::size_t channelParams(std::uint8_t status)
+  {
+    return (status >> 4 == 0x0C || status >> 4 == 0x0D) ? 1 : 2;
+  }
+
+  //Index of the lowest set bit of a nonzero number
+  static unsigned lowestBit(std::uint32_t bits)
+  {
+#ifdef __GNUC__
+    return __builtin_ctz(bits);
+#else
+    unsigned ret = 0;
+    while (!(bits & 1))
+      {
+        bits >>= 1;
+        ret++;
+      }
+    return ret;
+#endif
+  }
+
+  //Steps over a meta or SysEx event, starting at its status byte
+  static bool skipLongEvent(const std::uint8_t* & pos, const std::uint8_t* end)
+  {
+    std::uint8_t status = *pos++;
+    if (status == 0xFF)
+      {
+        if (pos == end) return false;
+        pos++;
+      }
+    std::uint32_t length;
+    if (!readVarLength(pos, end, length)) return false;
+    if (std::size_t(end - pos) < length) return false;
+    pos += length;
+    return true;
+  }
+
+  //Appends the delta times of the events from pos to end, a byte at a time
+  static bool scanBytes(const std::uint8_t* pos, const std::uint8_t* end,
+                        std::uint8_t & runningStatus,
+                        std::vector<std::uint32_t> & ticks)
+  {
+    while (pos != end)
+      {
+        std::uint32_t deltaTime;
+        if (!readVarLength(pos, end, deltaTime)) return false;
+        if (pos == end) return false;
+        ticks.push_back(deltaTime);
+
+        //Meta and SysEx events are skipped over whole
+        std::uint8_t status = *pos;
+        if (status == 0xFF || status == 0xF0 || status == 0xF7)
+          {
+            if (!skipLongEvent(pos, end)) return false;
+            continue;
+          }
+
+        //Channel events, possibly using running status
+        if (status & 0x80)
+          {
+            if (status >= 0xF0) return false;
+            runningStatus = status;
+            pos++;
+          }
+        else if (runningStatus == 0) return false;
+        std::size_t params = channelParams(runningStatus);
+        if (std::size_t(end - pos) < params) return false;
+        pos += params;
+      }
+    return true;
+  }
+
+#ifdef MIDI_TICKSCAN_SSE2
+  //High bits of 16 bytes
+  struct SSE2Block
+  {
+    static const std::size_t WIDTH = 16;
+    static std::uint32_t highBits(const std::uint8_t* pos)
+    {
+      __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+      return _mm_movemask_epi8(bytes);
+    }
+  };
+
+#ifdef MIDI_TICKSCAN_AVX2
+  //High bits of 32 bytes
+  struct AVX2Block
+  {
+    static const std::size_t WIDTH = 32;
+    __attribute__((target("avx2")))
+    static std::uint32_t highBits(const std::uint8_t* pos)
+    {
+      __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+      return _mm256_movemask_epi8(bytes);
+    }
+  };
+#endif
+
+  //Appends the delta times of the events from pos to end a block at a time.
+  //A set bit in a block's mask is a continuation byte within a delta time or a
+  //status byte after one, so delta time lengths and running status are read
+  //from the mask. Once the next channel event might cross the end of the
+  //block, or after a meta or SysEx event, the block is reloaded where it left
+  //off. The last partial block is walked a byte at a time.
+  template <class Block>
+  static bool scanBlocks(const std::uint8_t* pos, const std::uint8_t* end,
+                         std::uint8_t & runningStatus,
+                         std::vector<std::uint32_t> & ticks)
+  {
+    //Longest channel event: a full delta time, a status and two parameters
+    const std::size_t MAX_CHANNEL_EVENT = VARLENGTH_MAX_SIZE + 3;
+    const std::uint32_t TOO_LONG = 1u << VARLENGTH_MAX_SIZE;
+
+    while (std::size_t(end - pos) >= Block::WIDTH)
+      {
+        const std::uint8_t* block = pos;
+        std::uint32_t high = Block::highBits(block);
+        std::size_t offset = 0;
+        bool skipped = false;
+        while (offset + MAX_CHANNEL_EVENT <= Block::WIDTH)
+          {
+            std::uint32_t rest = high >> offset;
+            unsigned length = lowestBit(~rest | TOO_LONG) + 1;
+            if (length > unsigned(VARLENGTH_MAX_SIZE)) return false;
+
+            std::uint32_t deltaTime = 0;
+            for (unsigned i = 0; i < length; i++)
+              {
+                deltaTime = (deltaTime << 7) | (block[offset+i] & 0x7F);
+              }
+            ticks.push_back(deltaTime);
+            offset += length;
+
+            if ((rest >> length) & 1)
+              {
+                std::uint8_t status = block[offset];
+                if (status >= 0xF0)
+                  {
+                    if (status != 0xFF && status != 0xF0 && status != 0xF7) return false;
+                    pos = block + offset;
+                    if (!skipLongEvent(pos, end)) return false;
+                    skipped = true;
+                    break;
+                  }
+                runningStatus = status;
+                offset++;
+              }
+            else if (runningStatus == 0) return false;
+            offset += channelParams(runningStatus);
+          }
+        if (!skipped) pos = block + offset;
+      }
+    return scanBytes(pos, end, runningStatus, ticks);
+  }
+#endif
+
+#ifdef MIDI_TICKSCAN_AVX2
+  //Whether this CPU can run the AVX2 paths, checked once
+  static bool haveAVX2()
+  {
+    static const bool have = __builtin_cpu_supports("avx2");
+    return have;
+  }
+#endif
+
+  //Picks the widest block the CPU supports, then sums up the delta times
+  bool scanTicks(const std::uint8_t* pos, const std::uint8_t* end,
+                 std::vector<std::uint32_t> & ticks)
+  {
+    ticks.clear();
+    ticks.reserve((end - pos) / 3);
+    std::uint8_t runningStatus = 0;
+    bool ok;
+#if defined(MIDI_TICKSCAN_AVX2)
+    if (haveAVX2()) ok = scanBlocks<AVX2Block>(pos, end, runningStatus, ticks);
+    else ok = scanBlocks<SSE2Block>(pos, end, runningStatus, ticks);
+#elif defined(MIDI_TICKSCAN_SSE2)
+    ok = scanBlocks<SSE2Block>(pos, end, runningStatus, ticks);
+#else
+    ok = scanBytes(pos, end, runningStatus, ticks);
+#endif
+    if (!ok) return false;
+
+    if (!ticks.empty()) accumulateTicks(&ticks[0], ticks.size());
+    return true;
+  }
+
+#ifdef MIDI_TICKSCAN_AVX2
+  //Eight at a time: a shift-add prefix sum within each 128 bit lane, then the
+  //low lane's total added to the high lane and everything before the group
+  //added to all of it. Returns how many were done.
+  __attribute__((target("avx2")))
+  static std::size_t accumulateTicksAVX2(std::uint32_t* ticks, std::size_t count)
+  {
+    std::size_t i = 0;
+    __m256i carry = _mm256_setzero_si256();
+    const __m256i last = _mm256_set1_epi32(7);
+    for (; i + 8 <= count; i += 8)
+      {
+        __m256i* p = reinterpret_cast<__m256i*>(ticks + i);
+        __m256i x = _mm256_loadu_si256(p);
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        __m256i low = _mm256_permute2x128_si256(x, x, 0x08);
+        x = _mm256_add_epi32(x, _mm256_shuffle_epi32(low, _MM_SHUFFLE(3, 3, 3, 3)));
+        x = _mm256_add_epi32(x, carry);
+        _mm256_storeu_si256(p, x);
+        carry = _mm256_permutevar8x32_epi32(x, last);
+      }
+    return i;
+  }
+#endif
+
+  //Inclusive prefix sum. With SSE2, four at a time by adding shifted copies
+  //of each group to itself, then the total of everything before it.
+  void accumulateTicks(std::uint32_t* ticks, std::size_t count)
+  {
+    std::size_t i = 0;
+    std::uint32_t total = 0;
+#ifdef MIDI_TICKSCAN_AVX2
+    if (haveAVX2()) i = accumulateTicksAVX2(ticks, count);
+#endif
+#ifdef MIDI_TICKSCAN_SSE2
+    __m128i carry = _mm_set1_epi32(i > 0 ? int(ticks[i-1]) : 0);
+    for (; i + 4 <= count; i += 4)
+      {
+        __m128i* p = reinterpret_cast<__m128i*>(ticks + i);
+        __m128i x = _mm_loadu_si128(p);
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128(p, x);
+        carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+      }
+#endif
+    if (i > 0) total = ticks[i-1];
+    for (; i < count; i++)
+      {
+        total += ticks[i];
+        ticks[i] = total;
+      }
+  }
+
+} //Namespace
@@ -0,0 +1,34 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Tick Scanning Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains functions to find the absolute time of every event in raw track data
+  without building the events, for work that only needs timing. The raw data is
+  scanned in 16 or 32 byte blocks with SSE2 or AVX2 where available.
+*/
+
+#ifndef _tickscan_hpp_
+#define _tickscan_hpp_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace midi
+{
+
+  //Fills ticks with the absolute time of each event in the contents of an MTrk
+  //chunk, in order. Returns false if the track is malformed.
+  bool scanTicks(const std::uint8_t* pos, const std::uint8_t* end,
+                 std::vector<std::uint32_t> & ticks);
+
+  //Turns count delta times into absolute times, in place
+  void accumulateTicks(std::uint32_t* ticks, std::size_t count);
+
+} //Namespace
+
+#endif
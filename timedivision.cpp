@@ -54,4 +54,11 @@ namespace midi
     data_[1] = tpf;
   }
 
+  //Set directly from the two bytes found in a file header
+  void TimeDivision::setRaw(std::uint8_t high, std::uint8_t low)
+  {
+    data_[0] = high;
+    data_[1] = low;
+  }
+
 } //Namespace
@@ -27,6 +27,14 @@ namespace midi
     std::vector<std::uint8_t> data() const;
     void set(std::uint16_t ppqn);
     void set(std::uint8_t fps, std::uint8_t tpf);
+    void setRaw(std::uint8_t high, std::uint8_t low);
+
+    //Interpreting the data. SMPTE divisions have frames per second (24, 25,
+    //29 for 29.97 drop frame, or 30) and ticks per frame, others a PPQN.
+    bool smpte() const {return data_[0] & 0x80;}
+    std::uint16_t ppqn() const {return (std::uint16_t(data_[0] & 0x7F) << 8) | data_[1];}
+    std::uint8_t fps() const {return -std::int8_t(data_[0]);}
+    std::uint8_t ticksPerFrame() const {return data_[1];}
 
   private:
     std::vector<std::uint8_t> data_;
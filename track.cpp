@@ -10,12 +10,110 @@
 */
 
 #include "track.hpp"
+#include "tickscan.hpp"
+#include "compacttrack.hpp"
 
 #include <map>
+#include <cstring>
+#include <utility>
+#include <algorithm>
 
 namespace midi
 {
 
+  //Constructors
+  EventTrack::EventTrack() : runningStatus_(false), indexed_(false), arenaBytes_(0) {}
+
+  //All events of this track will be placed in the arena
+  EventTrack::EventTrack(const std::shared_ptr<EventArena> & arena) :
+    runningStatus_(false), indexed_(false), arena_(arena), arenaBytes_(0) {}
+
+  //Copies are deep, with an arena track's copy getting an arena of its own
+  EventTrack::EventTrack(const EventTrack & other) :
+    Track(), runningStatus_(false), indexed_(false), arenaBytes_(0)
+  {
+    copyEvents(other);
+  }
+
+  //Moves take the events, leaving the other track empty
+  EventTrack::EventTrack(EventTrack && other) :
+    Track(), event_(std::move(other.event_)), runningStatus_(other.runningStatus_),
+    indexed_(other.indexed_), time_(std::move(other.time_)),
+    arena_(std::move(other.arena_)), arenaBytes_(other.arenaBytes_)
+  {
+    other.event_.clear();
+    other.time_.clear();
+    other.arenaBytes_ = 0;
+  }
+
+  EventTrack & EventTrack::operator=(const EventTrack & other)
+  {
+    if (this == &other) return *this;
+    clear();
+    arena_.reset();
+    copyEvents(other);
+    return *this;
+  }
+
+  EventTrack & EventTrack::operator=(EventTrack && other)
+  {
+    if (this == &other) return *this;
+    clear();
+    event_ = std::move(other.event_);
+    runningStatus_ = other.runningStatus_;
+    indexed_ = other.indexed_;
+    time_ = std::move(other.time_);
+    arena_ = std::move(other.arena_);
+    arenaBytes_ = other.arenaBytes_;
+    other.event_.clear();
+    other.time_.clear();
+    other.arenaBytes_ = 0;
+    return *this;
+  }
+
+  //Copies the events of another track onto the end of this one
+  void EventTrack::copyEvents(const EventTrack & other)
+  {
+    runningStatus_ = other.runningStatus_;
+    setIndexed(other.indexed_);
+    if (other.arena_ && !arena_) arena_.reset(new EventArena);
+
+    event_.reserve(event_.size() + other.event_.size());
+    if (arena_)
+      {
+        //Space for all of an arena track's events and payloads is set aside in
+        //one block, and each is copied straight into it
+        std::size_t before = arena_->used();
+        if (other.arenaBytes_ > 0) arena_->reserve(other.arenaBytes_);
+        for (std::size_t i = 0; i < other.event_.size(); i++)
+          {
+            push(other.event_[i]->clone(*arena_));
+          }
+        arenaBytes_ += arena_->used() - before;
+        return;
+      }
+
+    for (std::size_t i = 0; i < other.event_.size(); i++)
+      {
+        push(other.event_[i]->clone());
+      }
+  }
+
+  //By default, streaming a track writes its data all at once
+  bool Track::write(ByteSink & sink) const
+  {
+    std::vector<std::uint8_t> out = data();
+    return out.empty() || sink.write(&out[0], out.size());
+  }
+
+  //By default, encoding a track copies its data
+  std::uint8_t* Track::encodeInto(std::uint8_t* out) const
+  {
+    std::vector<std::uint8_t> d = data();
+    if (!d.empty()) std::memcpy(out, &d[0], d.size());
+    return out + d.size();
+  }
+
   //Destructor
   EventTrack::~EventTrack()
   {
@@ -25,11 +123,21 @@ namespace midi
   //Clears the vector, freeing all Events
   void EventTrack::clear()
   {
-    for (std::size_t i = 0; i < event_.size(); i++)
+    if (arena_)
       {
-        delete event_[i];
+        //Events in an arena go all at once, when nobody else uses it
+        if (arena_.use_count() == 1) arena_->release();
+      }
+    else
+      {
+        for (std::size_t i = 0; i < event_.size(); i++)
+          {
+            delete event_[i];
+          }
       }
     event_.resize(0);
+    time_.clear();
+    arenaBytes_ = 0;
   }
 
   //Returns the size of the entire track
@@ -39,6 +147,16 @@ namespace midi
     std::size_t ret = 8;
 
     //Events
+    if (runningStatus_)
+      {
+        std::uint8_t status = 0;
+        for (std::size_t i = 0; i < event_.size(); i++)
+          {
+            ret += event_[i]->runningSize(status);
+          }
+        return ret;
+      }
+
     for (std::size_t i = 0; i < event_.size(); i++)
       {
         ret += event_[i]->size();
@@ -50,76 +168,309 @@ namespace midi
   //Adds an event to the end of the track
   void EventTrack::add(const Event & ev)
   {
-    Event* addition = ev.clone();
-    event_.push_back(addition);
+    if (arena_)
+      {
+        std::size_t before = arena_->used();
+        push(ev.clone(*arena_));
+        arenaBytes_ += arena_->used() - before;
+        return;
+      }
+
+    push(ev.clone());
+  }
+
+  //Adds an already allocated event to the end of the track, taking ownership
+  void EventTrack::adopt(Event* ev)
+  {
+    //An arena track keeps events already in its arena, and moves heap ones in
+    if (arena_ && !arena_->owns(ev))
+      {
+        add(*ev);
+        delete ev;
+        return;
+      }
+
+    //Arena events are never destroyed, so any payload they own moves in too
+    if (arena_) ev->payloadToArena(*arena_);
+    push(ev);
+  }
+
+  //Appends an event this track owns, updating the index
+  void EventTrack::push(Event* ev)
+  {
+    if (indexed_) time_.push_back((time_.empty() ? 0 : time_.back()) + ev->dt());
+    event_.push_back(ev);
+  }
+
+  //Turns the absolute time index on or off, building it from the events
+  void EventTrack::setIndexed(bool on)
+  {
+    indexed_ = on;
+    time_.clear();
+    if (!on || event_.empty()) return;
+
+    time_.resize(event_.size());
+    for (std::size_t i = 0; i < event_.size(); i++)
+      {
+        time_[i] = event_[i]->dt();
+      }
+    accumulateTicks(&time_[0], time_.size());
+  }
+
+  //Absolute time of event i
+  std::uint32_t EventTrack::time(std::size_t i) const
+  {
+    if (indexed_) return time_[i];
+
+    std::uint32_t ret = 0;
+    for (std::size_t j = 0; j <= i; j++)
+      {
+        ret += event_[j]->dt();
+      }
+    return ret;
+  }
+
+  //Index of the first event at or after tick, or the number of events
+  std::size_t EventTrack::lowerBound(std::uint32_t tick) const
+  {
+    if (indexed_) return std::lower_bound(time_.begin(), time_.end(), tick) - time_.begin();
+
+    std::uint32_t total = 0;
+    for (std::size_t i = 0; i < event_.size(); i++)
+      {
+        total += event_[i]->dt();
+        if (total >= tick) return i;
+      }
+    return event_.size();
+  }
+
+  //Iterator to the first event at or after tick
+  std::vector<Event*>::const_iterator EventTrack::seek(std::uint32_t tick) const
+  {
+    return event_.begin() + lowerBound(tick);
+  }
+
+  //Copies of the events in [begin, end), with times starting from begin
+  EventTrack EventTrack::range(std::uint32_t begin, std::uint32_t end) const
+  {
+    EventTrack track;
+    track.setRunningStatus(runningStatus_);
+    track.setIndexed(indexed_);
+    std::size_t first = lowerBound(begin);
+    std::size_t last = (end > begin) ? lowerBound(end) : first;
+    track.reserve(last - first);
+
+    for (std::size_t i = first; i < last; i++)
+      {
+        Event* ev = event_[i]->clone();
+        if (i == first) ev->setdt(time(i) - begin);
+        track.push(ev);
+      }
+    return track;
+  }
+
+  //Order of an event within its tick for EventTrack::normalized
+  static int eventRank(const Event* ev)
+  {
+    if (dynamic_cast<const MetaEvent*>(ev) != NULL) return 0;
+    if (dynamic_cast<const SysExEvent*>(ev) != NULL) return 1;
+
+    std::uint16_t note = ev->getNote();
+    if (note >= 128 && note < 256) return 2;
+    if (note < 128) return static_cast<const ChannelEvent*>(ev)->param2() == 0 ? 2 : 4;
+    return 3;
+  }
+
+  //Sorts copies of the events by tick and rank, dropping every End of Track
+  //and adding one back after everything else
+  EventTrack EventTrack::normalized() const
+  {
+    struct Entry
+    {
+      std::uint32_t tick;
+      int rank;
+      const Event* ev;
+    };
+
+    std::vector<Entry> entry;
+    entry.reserve(event_.size());
+    std::uint32_t tick = 0;
+    for (std::size_t i = 0; i < event_.size(); i++)
+      {
+        tick += event_[i]->dt();
+        const MetaEvent* meta = dynamic_cast<const MetaEvent*>(event_[i]);
+        if (meta != NULL && meta->metaType() == 0x2F) continue;
+        Entry e = {tick, eventRank(event_[i]), event_[i]};
+        entry.push_back(e);
+      }
+    std::stable_sort(entry.begin(), entry.end(), [](const Entry & a, const Entry & b)
+                     {return a.tick < b.tick || (a.tick == b.tick && a.rank < b.rank);});
+
+    EventTrack track;
+    track.setRunningStatus(runningStatus_);
+    track.setIndexed(indexed_);
+    track.reserve(entry.size() + 1);
+    std::uint32_t last = 0;
+    for (std::size_t i = 0; i < entry.size(); i++)
+      {
+        Event* ev = entry[i].ev->clone();
+        ev->setdt(entry[i].tick - last);
+        last = entry[i].tick;
+        track.push(ev);
+      }
+    track.push(new EndOfTrackEvent(tick - last));
+    return track;
   }
 
   //Combines all of the event data along with the header
   std::vector<std::uint8_t> EventTrack::data() const
   {
-    //Construct header
-    std::vector<std::uint8_t> out;
-    out.push_back('M');
-    out.push_back('T');
-    out.push_back('r');
-    out.push_back('k');
+    std::vector<std::uint8_t> out(size());
+    encodeInto(&out[0]);
+    return out;
+  }
+
+  //Writes the track header
+  std::uint8_t* EventTrack::encodeHeader(std::uint8_t* out) const
+  {
     std::size_t trackSize = size()-8;
-    out.push_back(trackSize >> 24);
-    out.push_back((trackSize >> 16)&0xFF);
-    out.push_back((trackSize >> 8)&0xFF);
-    out.push_back(trackSize&0xFF);
+    *out++ = 'M';
+    *out++ = 'T';
+    *out++ = 'r';
+    *out++ = 'k';
+    *out++ = trackSize >> 24;
+    *out++ = (trackSize >> 16)&0xFF;
+    *out++ = (trackSize >> 8)&0xFF;
+    *out++ = trackSize&0xFF;
+    return out;
+  }
 
-    //Add on every event's data
+  //Encodes the header and every event directly into out
+  std::uint8_t* EventTrack::encodeInto(std::uint8_t* out) const
+  {
+    out = encodeHeader(out);
+
+    std::uint8_t status = 0;
     for (std::size_t i = 0; i < event_.size(); i++)
       {
-        //Get the event's data
-        std::vector<std::uint8_t> eventData = event_[i]->data();
-
-        //Add it all
-        out.insert(out.end(), eventData.begin(), eventData.end());
+        if (runningStatus_) out = event_[i]->runningEncodeInto(out, status);
+        else out = event_[i]->encodeInto(out);
       }
 
     return out;
   }
 
+  //Streams the header and every event's data to the sink
+  bool EventTrack::write(ByteSink & sink) const
+  {
+    std::uint8_t header[8];
+    encodeHeader(header);
+    if (!sink.write(header, 8)) return false;
+
+    //Events are encoded into a small buffer between writes
+    std::uint8_t buffer[4096];
+    std::size_t used = 0;
+    std::uint8_t status = 0;
+    for (std::size_t i = 0; i < event_.size(); i++)
+      {
+        //Find how much room it needs
+        std::uint8_t sizeStatus = status;
+        std::size_t eventSize;
+        if (runningStatus_) eventSize = event_[i]->runningSize(sizeStatus);
+        else eventSize = event_[i]->size();
+
+        //Make room for it
+        if (used + eventSize > sizeof(buffer))
+          {
+            if (!sink.write(buffer, used)) return false;
+            used = 0;
+          }
+
+        //Anything too big for the buffer goes straight through
+        if (eventSize > sizeof(buffer))
+          {
+            std::vector<std::uint8_t> eventData;
+            if (runningStatus_) eventData = event_[i]->runningData(status);
+            else eventData = event_[i]->data();
+            if (!sink.write(&eventData[0], eventData.size())) return false;
+            continue;
+          }
+
+        if (runningStatus_) event_[i]->runningEncodeInto(buffer + used, status);
+        else event_[i]->encodeInto(buffer + used);
+        used += eventSize;
+      }
+
+    return used == 0 || sink.write(buffer, used);
+  }
+
   //Conversion from an EventTrack to a NoteTrack
   NoteTrack EventTrack::toNotes() const
   {
     //The only events we care about are Note On and Note Off events,
     //which will return their note from getNote. Note On returns the actual
     //note, Note Off returns the note + 128. Any other event returns 256.
-    NoteTrack track;
+    //A Note On with velocity 0 is a Note Off.
+    //Notes sounding on each channel and key are kept in a list, oldest first,
+    //so every Note Off ends the earliest note it can in one pass.
+    const std::uint32_t none = 0xFFFFFFFF;
+    std::vector<NoteTime> notes;
+    std::vector<std::uint32_t> next;
+    std::vector<bool> ended;
+    std::vector<std::uint32_t> first(16*128, none);
+    std::vector<std::uint32_t> last(16*128, none);
+
     std::uint32_t totalTime = 0;
     for (std::size_t i = 0; i < event_.size(); i++)
       {
         totalTime += event_[i]->dt();
         std::uint16_t val = event_[i]->getNote();
-      
-        if (val < 128)
+        if (val > 255) continue;
+
+        //Only channel events have notes
+        const ChannelEvent* ev = static_cast<const ChannelEvent*>(event_[i]);
+        std::size_t key = (ev->channel() & 0x0F)*128 + (val & 0x7F);
+
+        if (val < 128 && ev->param2() != 0)
           {
-            //Find the associated Note Off event
-            std::uint32_t duration = 0;
-            std::size_t j;
-            for (j = i+1; j < event_.size(); j++)
-              {
-                duration += event_[j]->dt();
-                if (event_[j]->getNote() == val+128) break;
-              }
-
-            if (j == event_.size()) continue;
-          
+            //Note On opens a note at the end of its key's list
             NoteTime nt;
             nt.note = val;
             nt.begin = totalTime;
-            nt.duration = duration;
+            nt.duration = 0;
             nt.instrument = Instrument::ACOUSTIC_GRAND_PIANO; //FOR NOW...
-            track.add(nt);
+            std::uint32_t index = notes.size();
+            notes.push_back(nt);
+            next.push_back(none);
+            ended.push_back(false);
+
+            if (last[key] == none) first[key] = index;
+            else next[last[key]] = index;
+            last[key] = index;
+          }
+        else
+          {
+            //Note Off ends the note at the front
+            std::uint32_t index = first[key];
+            if (index == none) continue;
+            notes[index].duration = totalTime - notes[index].begin;
+            ended[index] = true;
+            first[key] = next[index];
+            if (first[key] == none) last[key] = none;
           }
       }
 
+    //Notes which never ended are dropped
+    NoteTrack track;
+    for (std::size_t i = 0; i < notes.size(); i++)
+      {
+        if (ended[i]) track.add(notes[i]);
+      }
+
     return track;
   }
 
+
   //Typecast from an EventTrack to a NoteTrack
   EventTrack::operator NoteTrack() const
   {
@@ -127,28 +478,112 @@ namespace midi
   }
 
   //Clone function
+  //An arena track is cloned into a fresh arena holding all events in one block
   Track* EventTrack::clone() const
   {
-    EventTrack* et = new EventTrack;
-  
-    for (std::size_t i = 0; i < event_.size(); i++)
-      {
-        et->add(*event_[i]);
-      }
+    return new EventTrack(*this);
+  }
 
+  //Clones into the given arena
+  Track* EventTrack::cloneInto(const std::shared_ptr<EventArena> & arena) const
+  {
+    EventTrack* et = new EventTrack(arena);
+    et->copyEvents(*this);
     return et;
   }
 
+  //Moves the events into a new track without copying them
+  Track* EventTrack::moveClone()
+  {
+    return new EventTrack(std::move(*this));
+  }
+
+  //NoteTrack constructor
+  NoteTrack::NoteTrack()
+  {
+    clear();
+  }
+
+  //Copies take the encoding too, if it's up to date
+  NoteTrack::NoteTrack(const NoteTrack & other) : Track()
+  {
+    *this = other;
+  }
+
+  NoteTrack & NoteTrack::operator=(const NoteTrack & other)
+  {
+    if (this == &other) return *this;
+    note_ = other.note_;
+    {
+      std::lock_guard<std::mutex> lock(other.encodeMutex_);
+      encoded_ = other.encoded_;
+      dirty_ = other.dirty_.load();
+    }
+    lastPress_ = other.lastPress_;
+    lastRelease_ = other.lastRelease_;
+    std::memcpy(instrumentCount_, other.instrumentCount_, sizeof(instrumentCount_));
+    return *this;
+  }
+
+  //Moves take the notes and encoding, leaving the other track empty
+  NoteTrack::NoteTrack(NoteTrack && other) : Track()
+  {
+    *this = std::move(other);
+  }
+
+  NoteTrack & NoteTrack::operator=(NoteTrack && other)
+  {
+    if (this == &other) return *this;
+    note_ = std::move(other.note_);
+    encoded_ = std::move(other.encoded_);
+    dirty_ = other.dirty_.load();
+    lastPress_ = other.lastPress_;
+    lastRelease_ = other.lastRelease_;
+    std::memcpy(instrumentCount_, other.instrumentCount_, sizeof(instrumentCount_));
+    other.clear();
+    return *this;
+  }
+
   //Clears the NoteTrack
   void NoteTrack::clear()
   {
     note_.clear();
+    encoded_.clear();
+    dirty_ = true;
+    lastPress_ = 0;
+    lastRelease_ = 0;
+    std::memset(instrumentCount_, 0, sizeof(instrumentCount_));
   }
 
   //Returns the size of the data when converted to an EventTrack
   std::size_t NoteTrack::size() const
   {
-    return data().size();
+    encode();
+    return encoded_.size();
+  }
+
+  //Adds a note, marking the encoding out of date and updating the extents
+  void NoteTrack::push(const NoteTime & nt)
+  {
+    note_.push_back(nt);
+    dirty_ = true;
+    if (nt.begin > lastPress_) lastPress_ = nt.begin;
+    if (nt.begin + nt.duration > lastRelease_) lastRelease_ = nt.begin + nt.duration;
+    instrumentCount_[static_cast<std::uint8_t>(nt.instrument) & 0x7F]++;
+  }
+
+  //Packs the events of toEvents into a CompactTrack, defined below
+  static CompactTrack compactNotes(const std::vector<NoteTime> & note);
+
+  //Rebuilds the encoding if any notes changed since it was made. Threads
+  //which find it out of date wait for the first of them to rebuild it.
+  void NoteTrack::encode() const
+  {
+    if (!dirty_.load(std::memory_order_acquire)) return;
+    std::lock_guard<std::mutex> lock(encodeMutex_);
+    if (!dirty_.load(std::memory_order_relaxed)) return;
+    encoded_ = compactNotes(note_).data();
+    dirty_.store(false, std::memory_order_release);
   }
 
   //Adds a note in a few different ways
@@ -159,119 +594,169 @@ namespace midi
     nt.begin = time;
     nt.duration = duration;
     nt.instrument = instrument;
-    note_.push_back(nt);
+    push(nt);
   }
 
   void NoteTrack::add(NoteTime nt)
   {
-    note_.push_back(nt);
+    push(nt);
   }
 
   void NoteTrack::add(Chord chord, std::uint32_t time, std::uint32_t duration, Instrument instrument)
   {
     //Add each of the notes
-    for (std::set<Note>::const_iterator i = chord.notes().begin(); i != chord.notes().end(); i++)
+    for (Chord::const_iterator i = chord.notes().begin(); i != chord.notes().end(); i++)
       {
         NoteTime nt;
         nt.note = *i;
         nt.begin = time;
         nt.duration = duration;
         nt.instrument = instrument;
-        note_.push_back(nt);
+        push(nt);
       }
   }
 
   //Adds this note deltaTime after the last note begins
   void NoteTrack::addAfterLastPress(Note note, std::uint32_t deltaTime, std::uint32_t duration, Instrument instrument)
   {
-    std::uint32_t time = 0;
-    for (std::size_t i = 0; i < note_.size(); i++)
-      {
-        if (note_[i].begin > time) time = note_[i].begin;
-      }
-
-    time += deltaTime;
-
-    add(note, time, duration, instrument);
+    add(note, lastPress_ + deltaTime, duration, instrument);
   }
 
-  //TODO: Verify that this plays all notes at once
+  //All notes of the chord start together, deltaTime after the last note begins
   void NoteTrack::addAfterLastPress(Chord chord, std::uint32_t deltaTime, std::uint32_t duration, Instrument instrument)
   {
-    //Add each of the notes
-    for (std::set<Note>::const_iterator i = chord.notes().begin(); i != chord.notes().end(); i++)
+    add(chord, lastPress_ + deltaTime, duration, instrument);
+  }
+
+  //A Note On or Note Off waiting to be written by NoteTrack::toEvents
+  struct NoteEdge
+  {
+    std::uint32_t time;
+    std::uint8_t on;
+    std::uint8_t note;
+    std::uint8_t channel;
+  };
+
+  //Stable LSD radix sort of edges by time, a byte at a time
+  static void sortEdges(std::vector<NoteEdge> & edges)
+  {
+    std::vector<NoteEdge> temp(edges.size());
+    for (unsigned shift = 0; shift < 32; shift += 8)
       {
-        addAfterLastPress(*i, deltaTime, duration, instrument);
+        std::size_t count[257] = {0};
+        for (std::size_t i = 0; i < edges.size(); i++)
+          {
+            count[((edges[i].time >> shift) & 0xFF) + 1]++;
+          }
+
+        //Nothing to do if every edge has the same byte here
+        if (edges.empty() || count[((edges[0].time >> shift) & 0xFF) + 1] == edges.size())
+          continue;
+
+        for (std::size_t b = 1; b < 257; b++)
+          {
+            count[b] += count[b-1];
+          }
+        for (std::size_t i = 0; i < edges.size(); i++)
+          {
+            temp[count[(edges[i].time >> shift) & 0xFF]++] = edges[i];
+          }
+        edges.swap(temp);
       }
   }
 
-  //Conversion to EventTrack
-  EventTrack NoteTrack::toEvents() const
+  //Everything NoteTrack::toEvents writes, before it becomes events
+  struct NoteLayout
   {
-    //Create the event track
-    EventTrack track;
+    //Channel of each instrument, or UNUSED
+    static const std::uint8_t UNUSED = 0xFF;
+    std::uint8_t instrumentChannel[128];
+    std::size_t numInstruments;
+    std::vector<NoteEdge> edges;
 
-    //Add a few starting events
-    track.add(TimeSignatureEvent(0, 4, 4, 24, 8));
+    //Events it turns into
+    std::size_t events() const {return edges.size() + numInstruments + 2;}
+  };
+
+  //Time signature written at the start of every converted track
+  static const std::uint8_t TIME_SIGNATURE[4] = {4, 4, 24, 8};
 
-    //Find all of the instruments used in this track
-    std::map<Instrument, std::uint8_t> instrumentChannel;
+  //Gives each instrument a channel and puts the note edges in order
+  static void layoutNotes(const std::vector<NoteTime> & note, NoteLayout & out)
+  {
+    //Give each instrument a channel in order of first use
+    std::memset(out.instrumentChannel, NoteLayout::UNUSED, sizeof(out.instrumentChannel));
     std::uint8_t channel = 0;
-    for (std::size_t i = 0; i < note_.size(); i++)
+    out.numInstruments = 0;
+    for (std::size_t i = 0; i < note.size(); i++)
       {
-        if (instrumentChannel.find(note_[i].instrument) == instrumentChannel.end())
+        std::uint8_t inst = static_cast<std::uint8_t>(note[i].instrument) & 0x7F;
+        if (out.instrumentChannel[inst] == NoteLayout::UNUSED)
           {
-            instrumentChannel[note_[i].instrument] = channel;
+            out.instrumentChannel[inst] = channel;
+            out.numInstruments++;
             channel++;
             if (channel > 15) channel = 15;
           }
       }
 
-    for (std::map<Instrument, std::uint8_t>::iterator i = instrumentChannel.begin();
-         i != instrumentChannel.end(); i++)
+    //Lay out every Note On and Note Off. At equal times, Note Offs come
+    //before Note Ons so a repeated note is not cut short, except for notes
+    //with no duration, which must still start before they end.
+    std::vector<NoteEdge> & edges = out.edges;
+    edges.clear();
+    edges.reserve(note.size()*2);
+    for (int pass = 0; pass < 3; pass++)
       {
-        track.add(ProgramChangeEvent(0, i->second, i->first));
+        for (std::size_t i = 0; i < note.size(); i++)
+          {
+            const NoteTime & nt = note[i];
+            if (pass != 1 && (nt.duration == 0) != (pass == 2)) continue;
+            NoteEdge edge;
+            edge.time = nt.begin + (pass == 1 ? 0 : nt.duration);
+            edge.on = (pass == 1);
+            edge.note = nt.note.midiVal();
+            edge.channel = out.instrumentChannel[static_cast<std::uint8_t>(nt.instrument) & 0x7F];
+            edges.push_back(edge);
+          }
       }
+    sortEdges(edges);
+  }
+
+  //The events are placed in an arena of the track's own, sized up front,
+  //rather than allocated one by one
+  EventTrack NoteTrack::toEvents() const
+  {
+    NoteLayout layout;
+    layoutNotes(note_, layout);
 
-    //Create a priority queue
-    std::priority_queue<NoteTime, std::vector<NoteTime>, NoteTimeComparer> queue;
+    std::shared_ptr<EventArena> arena(new EventArena);
+    const std::size_t align = EventArena::ALIGN;
+    std::size_t eventBytes = (sizeof(NoteOnEvent) + align - 1) / align * align;
+    arena->reserve(layout.events() * eventBytes + sizeof(TimeSignatureEvent) +
+                   sizeof(EndOfTrackEvent) + 4 * align);
+    EventTrack track(arena);
+    track.reserve(layout.events());
 
-    //For each note
-    for (std::size_t i = 0; i < note_.size(); i++)
+    //Add a few starting events
+    track.add(TimeSignatureEvent(0, TIME_SIGNATURE[0], TIME_SIGNATURE[1],
+                                 TIME_SIGNATURE[2], TIME_SIGNATURE[3]));
+    for (std::size_t i = 0; i < 128; i++)
       {
-        //Add both the Note On and Note Off events
-        queue.push(note_[i]);
-        NoteTime off;
-        off.note = note_[i].note;
-        off.begin = note_[i].begin + note_[i].duration;
-        off.duration = 0;
-        off.instrument = note_[i].instrument;
-        queue.push(off);
+        if (layout.instrumentChannel[i] == NoteLayout::UNUSED) continue;
+        track.adopt(new (*arena) ProgramChangeEvent(0, layout.instrumentChannel[i],
+                                                    static_cast<Instrument>(i)));
       }
 
     //Fill up the EventTrack
     std::uint32_t prevTime = 0;
-    while (!queue.empty())
+    for (std::size_t i = 0; i < layout.edges.size(); i++)
       {
-        //Get the next NoteTime
-        NoteTime nt = queue.top();
-        queue.pop();
-
-        //Find the deltaTime
-        std::uint32_t deltaTime;
-        deltaTime = nt.begin - prevTime;
-        prevTime = nt.begin;
-
-        //Check if it's a Note On or Note Off event
-        if (nt.duration != 0) //Note On
-          {
-            //Create the event and add it
-            track.add(NoteOnEvent(deltaTime, instrumentChannel[nt.instrument], nt.note.midiVal(), 127));
-          }
-        else //Note off
-          {
-            track.add(NoteOffEvent(deltaTime, instrumentChannel[nt.instrument], nt.note.midiVal(), 127));
-          }
+        const NoteEdge & edge = layout.edges[i];
+        std::uint32_t deltaTime = edge.time - prevTime;
+        prevTime = edge.time;
+        if (edge.on) track.adopt(new (*arena) NoteOnEvent(deltaTime, edge.channel, edge.note, 127));
+        else track.adopt(new (*arena) NoteOffEvent(deltaTime, edge.channel, edge.note, 127));
       }
 
     //Add an End Of Track event
@@ -280,6 +765,34 @@ namespace midi
     return track;
   }
 
+  //The same events as toEvents, packed straight into records
+  static CompactTrack compactNotes(const std::vector<NoteTime> & note)
+  {
+    NoteLayout layout;
+    layoutNotes(note, layout);
+
+    CompactTrack track;
+    track.reserve(layout.events(), sizeof(TIME_SIGNATURE));
+    track.addMeta(0, 0x58, TIME_SIGNATURE, sizeof(TIME_SIGNATURE));
+    for (std::size_t i = 0; i < 128; i++)
+      {
+        if (layout.instrumentChannel[i] == NoteLayout::UNUSED) continue;
+        track.addChannel(0, 0xC0 | layout.instrumentChannel[i], std::uint8_t(i));
+      }
+
+    std::uint32_t prevTime = 0;
+    for (std::size_t i = 0; i < layout.edges.size(); i++)
+      {
+        const NoteEdge & edge = layout.edges[i];
+        std::uint8_t status = (edge.on ? 0x90 : 0x80) | edge.channel;
+        track.addChannel(edge.time - prevTime, status, edge.note, 127);
+        prevTime = edge.time;
+      }
+
+    track.addMeta(0, 0x2F, NULL, 0);
+    return track;
+  }
+
   //Typecast to EventTrack
   NoteTrack::operator EventTrack() const
   {
@@ -289,20 +802,35 @@ namespace midi
   //Data, which only really makes sense as an EventTrack
   std::vector<std::uint8_t> NoteTrack::data() const
   {
-    return toEvents().data();
+    encode();
+    return encoded_;
+  }
+
+  //Streaming writes the cached encoding
+  bool NoteTrack::write(ByteSink & sink) const
+  {
+    encode();
+    return sink.write(&encoded_[0], encoded_.size());
+  }
+
+  //So does encoding
+  std::uint8_t* NoteTrack::encodeInto(std::uint8_t* out) const
+  {
+    encode();
+    std::memcpy(out, &encoded_[0], encoded_.size());
+    return out + encoded_.size();
   }
 
   //Clone function
   Track* NoteTrack::clone() const
   {
-    NoteTrack* et = new NoteTrack;
-  
-    for (std::size_t i = 0; i < note_.size(); i++)
-      {
-        et->add(note_[i]);
-      }
+    return new NoteTrack(*this);
+  }
 
-    return et;
+  //Moves the notes into a new track without copying them
+  Track* NoteTrack::moveClone()
+  {
+    return new NoteTrack(std::move(*this));
   }
 
 } //Namespace
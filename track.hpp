@@ -14,9 +14,13 @@
 
 #include "event.hpp"
 #include "note.hpp"
+#include "sink.hpp"
+#include "arena.hpp"
 
 #include <vector>
-#include <queue>
+#include <memory>
+#include <mutex>
+#include <atomic>
 
 namespace midi
 {
@@ -30,15 +34,6 @@ namespace midi
     Instrument instrument;
   };
 
-  class NoteTimeComparer
-  {
-  public:
-    bool operator()(const NoteTime & nt1, const NoteTime & nt2)
-    {
-      return nt1.begin > nt2.begin;
-    }
-  };
-
   //Forward declaration of NoteTrack
   class NoteTrack;
 
@@ -52,9 +47,21 @@ namespace midi
     virtual void clear() = 0;
     virtual std::size_t size() const = 0;
     virtual Track* clone() const = 0;
+
+    //Clone, placing events in the given arena where the track supports it
+    virtual Track* cloneInto(const std::shared_ptr<EventArena> &) const {return clone();}
+
+    //Moves the contents into a newly allocated track, leaving this one empty
+    virtual Track* moveClone() {return clone();}
   
     //Retrieve the contents of the track as a vector of uint8_t's
     virtual std::vector<std::uint8_t> data() const = 0;
+
+    //Stream the contents of the track to a sink
+    virtual bool write(ByteSink & sink) const;
+
+    //Write exactly size() bytes of data starting at out, returning the end
+    virtual std::uint8_t* encodeInto(std::uint8_t* out) const;
   
   private:
   };
@@ -64,31 +71,102 @@ namespace midi
   {
   public:
     //Standard stuff
+    EventTrack();
+    explicit EventTrack(const std::shared_ptr<EventArena> & arena);
+    EventTrack(const EventTrack & other);
+    EventTrack(EventTrack && other);
+    EventTrack & operator=(const EventTrack & other);
+    EventTrack & operator=(EventTrack && other);
     ~EventTrack();
   
     //Operations on the events
     void clear();
     std::size_t size() const;
     void add(const Event & ev);
-  
-    //Implementation of Track::data
+
+    //Takes ownership of an event allocated with new, or with new (arena) from
+    //this track's arena. Heap events given to an arena track are copied into
+    //the arena and deleted, so arena tracks are best built in place. A payload
+    //owned by an event built in place is copied into the arena as well.
+    void adopt(Event* ev);
+    void reserve(std::size_t events) {event_.reserve(events);}
+
+    //Accessor for read-only examination or debugging
+    const std::vector<Event*> & event() const {return event_;}
+
+    //Arena the events are allocated from, if any
+    const std::shared_ptr<EventArena> & arena() const {return arena_;}
+
+    //Running status encoding for size and data, off by default
+    void setRunningStatus(bool on) {runningStatus_ = on;}
+    bool runningStatus() const {return runningStatus_;}
+
+    //Index of the absolute time of every event, off by default. While it's on,
+    //it is kept up to date as events are added and seeking is O(log n).
+    //Changing the delta time of an event already in the track makes it stale.
+    void setIndexed(bool on);
+    bool indexed() const {return indexed_;}
+
+    //Seeking by absolute time, with a linear scan when there is no index
+    std::uint32_t time(std::size_t i) const;
+    std::size_t lowerBound(std::uint32_t tick) const;
+    std::vector<Event*>::const_iterator seek(std::uint32_t tick) const;
+
+    //Copies of the events in [begin, end), with times starting from begin
+    EventTrack range(std::uint32_t begin, std::uint32_t end) const;
+
+    //Copy with the events of each tick in a canonical order: meta, SysEx,
+    //note offs, other channel events, then note ons. Any End of Track events
+    //are replaced by a single one at the last tick.
+    EventTrack normalized() const;
+
+    //Implementation of Track::data, Track::write and Track::encodeInto
     std::vector<std::uint8_t> data() const;
+    bool write(ByteSink & sink) const;
+    std::uint8_t* encodeInto(std::uint8_t* out) const;
 
     //Convert to NoteTrack
     NoteTrack toNotes() const;
     operator NoteTrack() const;
 
-    //Clone function
+    //Clone functions
     Track* clone() const;
+    Track* cloneInto(const std::shared_ptr<EventArena> & arena) const;
+    Track* moveClone();
   
   private:
+    //Writes the track header
+    std::uint8_t* encodeHeader(std::uint8_t* out) const;
+
+    //Copies the events of another track onto the end of this one
+    void copyEvents(const EventTrack & other);
+
+    //Appends an event this track owns, updating the index
+    void push(Event* ev);
+
     std::vector<Event*> event_;
+    bool runningStatus_;
+
+    //Absolute time of each event, when indexed
+    bool indexed_;
+    std::vector<std::uint32_t> time_;
+
+    //Events come from here instead of new when set
+    std::shared_ptr<EventArena> arena_;
+    std::size_t arenaBytes_;
   };
 
   //A track the way human beans see it: as a series of notes
   class NoteTrack : public Track
   {
   public:
+    //Standard stuff
+    NoteTrack();
+    NoteTrack(const NoteTrack & other);
+    NoteTrack(NoteTrack && other);
+    NoteTrack & operator=(const NoteTrack & other);
+    NoteTrack & operator=(NoteTrack && other);
+
     //Operations on the notes
     void clear();
     std::size_t size() const;
@@ -104,21 +182,48 @@ namespace midi
                            std::uint32_t duration,
                            Instrument instrument = Instrument::ACOUSTIC_GRAND_PIANO);
 
-    //Implementation of Track::data
+    //Implementation of Track::data, Track::write and Track::encodeInto
     std::vector<std::uint8_t> data() const;
+    bool write(ByteSink & sink) const;
+    std::uint8_t* encodeInto(std::uint8_t* out) const;
 
     //Accessor for read-only examination or debugging
     const std::vector<NoteTime> & note() const {return note_;}
 
+    //Extents of the track, kept up to date as notes are added
+    std::uint32_t lastPress() const {return lastPress_;}
+    std::uint32_t lastRelease() const {return lastRelease_;}
+    std::uint32_t instrumentCount(Instrument instrument) const
+    {return instrumentCount_[static_cast<std::uint8_t>(instrument) & 0x7F];}
+
     //Convert to EventTrack
     EventTrack toEvents() const;
     operator EventTrack() const;
 
-    //Clone function
+    //Clone functions
     Track* clone() const;
+    Track* moveClone();
   
   private:
+    //Adds a note, marking the encoding out of date
+    void push(const NoteTime & nt);
+
+    //Rebuilds the encoding if any notes changed since it was made
+    void encode() const;
+
     std::vector<NoteTime> note_;
+
+    //The track as encoded by toEvents, kept until the notes change. The const
+    //functions may build it from several threads at once, so building is
+    //done under the lock and only once.
+    mutable std::vector<std::uint8_t> encoded_;
+    mutable std::atomic<bool> dirty_;
+    mutable std::mutex encodeMutex_;
+
+    //Latest start and end of any note, and how many notes each instrument has
+    std::uint32_t lastPress_;
+    std::uint32_t lastRelease_;
+    std::uint32_t instrumentCount_[128];
   };
 
 } //Namespace
@@ -0,0 +1,217 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----MIDI Validator Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the implementation of the structural validator, which checks the
+  raw bytes of a Standard MIDI File without decoding any events.
+*/
+
+#include "validator.hpp"
+#include "mappedfile.hpp"
+
+namespace midi
+{
+
+  //Names of the error codes
+  const char* ValidationError::describe() const
+  {
+    switch (code)
+      {
+      case NONE: return "valid";
+      case TRUNCATED_HEADER: return "truncated header";
+      case BAD_HEADER_ID: return "not a MIDI file";
+      case BAD_HEADER_LENGTH: return "bad header length";
+      case BAD_FORMAT: return "unknown format";
+      case BAD_TRACK_COUNT: return "type 0 file without one track";
+      case BAD_TIME_DIVISION: return "bad time division";
+      case TRUNCATED_CHUNK: return "truncated chunk header";
+      case CHUNK_OVERRUN: return "chunk longer than the file";
+      case MISSING_TRACKS: return "missing tracks";
+      case VARLENGTH_TOO_LONG: return "variable length value too long";
+      case TRUNCATED_EVENT: return "truncated event";
+      case NO_RUNNING_STATUS: return "data byte without running status";
+      case ILLEGAL_STATUS: return "illegal status byte";
+      case BAD_DATA_BYTE: return "bad data byte";
+      case BAD_META_TYPE: return "bad meta event type";
+      case BAD_END_OF_TRACK: return "End of Track event with data";
+      case EVENTS_AFTER_END: return "events after End of Track";
+      case MISSING_END_OF_TRACK: return "missing End of Track";
+      case UNREADABLE: return "could not be read";
+      }
+    return "unknown error";
+  }
+
+  //Reads a big-endian 32 bit chunk length
+  static std::uint32_t readChunkSize(const std::uint8_t* p)
+  {
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+      (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+  }
+
+  //Skips a variable length value, telling apart running out of bytes and
+  //a value that's too long. Returns NONE on success.
+  static ValidationError::Code skipVarLength(const std::uint8_t* & pos,
+                                             const std::uint8_t* end,
+                                             std::uint32_t & value)
+  {
+    value = 0;
+    for (int i = 0; i < 4; i++)
+      {
+        if (pos == end) return ValidationError::TRUNCATED_EVENT;
+        std::uint8_t byte = *pos++;
+        value = (value << 7) | (byte & 0x7F);
+        if (!(byte & 0x80)) return ValidationError::NONE;
+      }
+    pos--;
+    return ValidationError::VARLENGTH_TOO_LONG;
+  }
+
+  //Checks the events of one MTrk chunk
+  static ValidationError validateTrack(const std::uint8_t* base, const std::uint8_t* pos,
+                                       const std::uint8_t* end, std::size_t track)
+  {
+    //Number of parameters for each status nibble 0x8 to 0xE
+    static const std::uint8_t params[16] = {0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 1, 1, 2, 0};
+
+    std::uint8_t runningStatus = 0;
+    std::uint32_t value;
+    ValidationError::Code code;
+    while (pos != end)
+      {
+        //Delta time
+        const std::uint8_t* start = pos;
+        if ((code = skipVarLength(pos, end, value)) != ValidationError::NONE)
+          return ValidationError(code, pos - base, track);
+        if (pos == end) return ValidationError(ValidationError::TRUNCATED_EVENT, start - base, track);
+
+        std::uint8_t status = *pos;
+
+        //Channel events, the common case, checked first
+        if (status < 0xF0)
+          {
+            const std::uint8_t* statusPos = pos;
+            if (status & 0x80)
+              {
+                runningStatus = status;
+                pos++;
+              }
+            else if (runningStatus == 0)
+              {
+                return ValidationError(ValidationError::NO_RUNNING_STATUS, pos - base, track);
+              }
+
+            std::size_t count = params[runningStatus >> 4];
+            if (std::size_t(end - pos) < count)
+              return ValidationError(ValidationError::TRUNCATED_EVENT, statusPos - base, track);
+            for (std::size_t i = 0; i < count; i++)
+              {
+                if (pos[i] & 0x80)
+                  return ValidationError(ValidationError::BAD_DATA_BYTE, pos + i - base, track);
+              }
+            pos += count;
+            continue;
+          }
+
+        //Meta and SysEx events say how long they are
+        const std::uint8_t* statusPos = pos++;
+        std::uint8_t type = 0;
+        if (status == 0xFF)
+          {
+            if (pos == end)
+              return ValidationError(ValidationError::TRUNCATED_EVENT, statusPos - base, track);
+            type = *pos;
+            if (type & 0x80) return ValidationError(ValidationError::BAD_META_TYPE, pos - base, track);
+            pos++;
+          }
+        else if (status != 0xF0 && status != 0xF7)
+          {
+            return ValidationError(ValidationError::ILLEGAL_STATUS, statusPos - base, track);
+          }
+
+        const std::uint8_t* lengthPos = pos;
+        if ((code = skipVarLength(pos, end, value)) != ValidationError::NONE)
+          return ValidationError(code, pos - base, track);
+        if (std::size_t(end - pos) < value)
+          return ValidationError(ValidationError::TRUNCATED_EVENT, statusPos - base, track);
+        pos += value;
+
+        //End of Track must be empty and last
+        if (status == 0xFF && type == 0x2F)
+          {
+            if (value != 0)
+              return ValidationError(ValidationError::BAD_END_OF_TRACK, lengthPos - base, track);
+            if (pos != end)
+              return ValidationError(ValidationError::EVENTS_AFTER_END, pos - base, track);
+            return ValidationError();
+          }
+      }
+
+    return ValidationError(ValidationError::MISSING_END_OF_TRACK, end - base, track);
+  }
+
+  //Checks a whole file
+  ValidationError validate(const std::uint8_t* data, std::size_t size)
+  {
+    //Header chunk
+    if (size < 14) return ValidationError(ValidationError::TRUNCATED_HEADER, size, 0);
+    if (data[0] != 'M' || data[1] != 'T' || data[2] != 'h' || data[3] != 'd')
+      return ValidationError(ValidationError::BAD_HEADER_ID, 0, 0);
+    std::uint32_t headerSize = readChunkSize(data + 4);
+    if (headerSize < 6 || size - 8 < headerSize)
+      return ValidationError(ValidationError::BAD_HEADER_LENGTH, 4, 0);
+
+    std::uint16_t type = (std::uint16_t(data[8]) << 8) | data[9];
+    std::uint16_t numTracks = (std::uint16_t(data[10]) << 8) | data[11];
+    if (type > 2) return ValidationError(ValidationError::BAD_FORMAT, 8, 0);
+    if (type == 0 && numTracks != 1) return ValidationError(ValidationError::BAD_TRACK_COUNT, 10, 0);
+
+    //SMPTE divisions give a negative frame rate, otherwise ticks per beat
+    if (data[12] & 0x80)
+      {
+        int fps = -int(std::int8_t(data[12]));
+        if ((fps != 24 && fps != 25 && fps != 29 && fps != 30) || data[13] == 0)
+          return ValidationError(ValidationError::BAD_TIME_DIVISION, 12, 0);
+      }
+    else if (data[12] == 0 && data[13] == 0)
+      {
+        return ValidationError(ValidationError::BAD_TIME_DIVISION, 12, 0);
+      }
+
+    //Track chunks, skipping any we don't know
+    const std::uint8_t* pos = data + 8 + headerSize;
+    const std::uint8_t* end = data + size;
+    std::size_t tracks = 0;
+    while (tracks < numTracks)
+      {
+        if (pos == end) return ValidationError(ValidationError::MISSING_TRACKS, pos - data, tracks);
+        if (end - pos < 8) return ValidationError(ValidationError::TRUNCATED_CHUNK, pos - data, tracks);
+        std::uint32_t chunkSize = readChunkSize(pos + 4);
+        if (std::size_t(end - pos - 8) < chunkSize)
+          return ValidationError(ValidationError::CHUNK_OVERRUN, pos + 4 - data, tracks);
+
+        const std::uint8_t* chunk = pos + 8;
+        bool isTrack = (pos[0] == 'M' && pos[1] == 'T' && pos[2] == 'r' && pos[3] == 'k');
+        pos = chunk + chunkSize;
+        if (!isTrack) continue;
+
+        ValidationError err = validateTrack(data, chunk, pos, tracks);
+        if (!err.ok()) return err;
+        tracks++;
+      }
+
+    return ValidationError();
+  }
+
+  //Checks a file on disk, mapping it rather than reading it
+  ValidationError validate(const std::string & filename)
+  {
+    MappedFile file(filename);
+    if (!file.valid()) return ValidationError(ValidationError::UNREADABLE, 0, 0);
+    return validate(file.data(), file.size());
+  }
+
+} //Namespace
@@ -0,0 +1,75 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----MIDI Validator Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Contains the header for the structural validator, which checks the raw bytes
+  of a Standard MIDI File without decoding any events.
+*/
+
+#ifndef _validator_hpp_
+#define _validator_hpp_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace midi
+{
+
+  //The first problem found in a file, and where it is
+  struct ValidationError
+  {
+    enum Code
+    {
+      NONE,
+      TRUNCATED_HEADER,     //Fewer than 14 bytes
+      BAD_HEADER_ID,        //Doesn't start with MThd
+      BAD_HEADER_LENGTH,    //MThd shorter than 6 bytes or longer than the file
+      BAD_FORMAT,           //Not type 0, 1 or 2
+      BAD_TRACK_COUNT,      //Type 0 without exactly one track
+      BAD_TIME_DIVISION,    //0 ticks, or an SMPTE rate that doesn't exist
+      TRUNCATED_CHUNK,      //Chunk header cut off by the end of the file
+      CHUNK_OVERRUN,        //Chunk length goes past the end of the file
+      MISSING_TRACKS,       //Fewer MTrk chunks than the header says
+      VARLENGTH_TOO_LONG,   //Variable length value longer than 4 bytes
+      TRUNCATED_EVENT,      //Event cut off by the end of its chunk
+      NO_RUNNING_STATUS,    //Data byte with no status byte before it
+      ILLEGAL_STATUS,       //System common or realtime status in a track
+      BAD_DATA_BYTE,        //Channel event parameter with the high bit set
+      BAD_META_TYPE,        //Meta event type with the high bit set
+      BAD_END_OF_TRACK,     //End of Track event with data
+      EVENTS_AFTER_END,     //Events after End of Track in the same chunk
+      MISSING_END_OF_TRACK, //Track without an End of Track event
+      UNREADABLE            //File couldn't be opened
+    };
+
+    ValidationError() : code(NONE), offset(0), track(0) {}
+    ValidationError(Code c, std::size_t off, std::size_t tr) :
+      code(c), offset(off), track(tr) {}
+
+    bool ok() const {return code == NONE;}
+
+    //Readable name of the code
+    const char* describe() const;
+
+    Code code;
+
+    //Byte offset in the file of the first bad byte
+    std::size_t offset;
+
+    //Index of the MTrk chunk it's in, if it's in one
+    std::size_t track;
+  };
+
+  //Checks chunk framing, lengths, status bytes and running status in one
+  //pass without allocating. Anything that passes can be loaded.
+  ValidationError validate(const std::uint8_t* data, std::size_t size);
+  ValidationError validate(const std::string & filename);
+
+} //Namespace
+
+#endif
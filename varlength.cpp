@@ -16,104 +16,65 @@
 namespace midi
 {
 
-  //Default constructor, all zeros
-  VarLength::VarLength()
+  //Writes the size() bytes of this VarLength starting at out, returning the end
+  std::uint8_t* VarLength::encodeInto(std::uint8_t* out) const
   {
-    for (int i = 0; i < VARLENGTH_MAX_SIZE; i++)
+    //Most significant byte first
+    for (std::size_t i = size(); i > 0; i--)
       {
-        data_[i] = 0;
+        *out++ = bytes_ >> 8*(i - 1);
       }
+    return out;
   }
 
-  //Copy constructor
-  VarLength::VarLength(const VarLength& vl)
+  //Reads a variable-length number from raw bytes
+  bool readVarLength(const std::uint8_t* & pos, const std::uint8_t* end,
+                     std::uint32_t & value)
   {
+    const std::uint8_t* p = pos;
+    value = 0;
     for (int i = 0; i < VARLENGTH_MAX_SIZE; i++)
       {
-        data_[i] = vl.data_[i];
-      }
-  }
-
-  //Constructor from uint32_t
-  //Since this class can hold 28 bits, this uses the lower 28 bits of the uint32_t
-  VarLength::VarLength(std::uint32_t in)
-  {
-    //Copy over 7 bits at a time
-    for (int i = VARLENGTH_MAX_SIZE-1; i >= 0; i--)
-      {
-        data_[i] = in & 0x7F;
-        in >>= 7;
-      }
-
-    //Assign most significant bits appropriately
-    //Last byte always has 0
-    data_[VARLENGTH_MAX_SIZE-1] &= ~0x80;
-
-    //For all other bytes
-    bool begin = false;
-    for (int i = 0; i < VARLENGTH_MAX_SIZE-1; i++)
-      {
-        //If it's zero and we're not inbetween (1 0 1)
-        if (data_[i] == 0 && !begin)
+        if (p == end) return false;
+        std::uint8_t byte = *p++;
+        value = (value << 7) | (byte & 0x7F);
+        if (!(byte & 0x80))
           {
-            //Set to 0
-            data_[i] &= ~0x80;
-          }
-        else //Value or inbetween
-          {
-            data_[i] |= 0x80;
-            begin = true;
+            pos = p;
+            return true;
           }
       }
-  }
 
-  //Typecast from VarLength to std::uint32_t
-  VarLength::operator std::uint32_t() const
-  {
-    //Create output
-    std::uint32_t ret = 0;
-
-    //Add each component
-    for (int i = VARLENGTH_MAX_SIZE-1; i >= 0; i--)
-      {
-        ret += (data_[i] & 0x7F) << 7*(VARLENGTH_MAX_SIZE - 1 - i);
-      }
-
-    //Return the answer
-    return ret;
-  }
-
-  std::uint8_t VarLength::operator[](unsigned char index) const
-  {
-    //Align with actual data
-    index += VARLENGTH_MAX_SIZE-size();
-    return data_[index];
+    //Too many continuation bytes
+    return false;
   }
 
-  //Assignment operator
-  VarLength& VarLength::operator=(const VarLength& vl)
+  //Encodes an array of numbers
+  std::uint8_t* encodeVarLengths(const std::uint32_t* values, std::size_t count,
+                                 std::uint8_t* out)
   {
-    for (int i = 0; i < VARLENGTH_MAX_SIZE; i++)
+    for (std::size_t i = 0; i < count; i++)
       {
-        data_[i] = vl.data_[i];
+        out = VarLength(values[i]).encodeInto(out);
       }
-
-    return *this;
+    return out;
   }
 
-  //Returns the size in bytes of this VarLength
-  std::size_t VarLength::size() const
+  //Decodes an array of numbers
+  const std::uint8_t* decodeVarLengths(const std::uint8_t* pos, const std::uint8_t* end,
+                                       std::uint32_t* values, std::size_t count)
   {
-    //Starting size is 1
-    std::size_t ret = 1;
-
-    //Check most significant bits to determine length
-    for (int i = VARLENGTH_MAX_SIZE-2; i >= 0; i--)
+    for (std::size_t i = 0; i < count; i++)
       {
-        if (data_[i] & 0x80) ret++;
+        //Single byte numbers are by far the most common
+        if (pos != end && *pos < 0x80)
+          {
+            values[i] = *pos++;
+            continue;
+          }
+        if (!readVarLength(pos, end, values[i])) return NULL;
       }
-
-    return ret;
+    return pos;
   }
 
 } //Namespace
@@ -15,6 +15,7 @@
 #define _varlength_hpp_
 
 #include <cstdint>
+#include <cstddef>
 #include <string>
 
 namespace midi
@@ -26,22 +27,62 @@ namespace midi
   {
   public:
     //Constructors
-    VarLength();
-    VarLength(const VarLength& vl);
-    VarLength(std::uint32_t in);
+    //Since this class can hold 28 bits, this uses the lower 28 bits of the uint32_t
+    constexpr VarLength() : bytes_(0) {}
+    constexpr VarLength(std::uint32_t in) : bytes_(layout(in & 0x0FFFFFFF)) {}
   
     //Operators and typecasts
-    operator std::uint32_t() const;
-    VarLength& operator=(const VarLength& vl);
-    std::uint8_t operator[](unsigned char index) const;
+    constexpr operator std::uint32_t() const
+    {
+      return (bytes_ & 0x7F) | ((bytes_ >> 1) & 0x3F80) |
+        ((bytes_ >> 2) & 0x1FC000) | ((bytes_ >> 3) & 0xFE00000);
+    }
+    constexpr std::uint8_t operator[](unsigned char index) const
+    {
+      return index < size() ? std::uint8_t(bytes_ >> 8*(size() - 1 - index)) : 0;
+    }
     
     //Other useful functions
-    std::size_t size() const;
+    //Every byte above the last has its continuation bit set, so is nonzero
+    constexpr std::size_t size() const
+    {
+      return 1 + (bytes_ > 0xFF) + (bytes_ > 0xFFFF) + (bytes_ > 0xFFFFFF);
+    }
+    std::uint8_t* encodeInto(std::uint8_t* out) const;
+
+    //Size of the encoding of a number without building a VarLength
+    static constexpr std::size_t size(std::uint32_t value)
+    {
+      return 1 + (value > 0x7F) + (value > 0x3FFF) + (value > 0x1FFFFF);
+    }
+
   private:
-    //The number itself
-    std::uint8_t data_[VARLENGTH_MAX_SIZE];
+    //Spreads the number out 7 bits per byte and sets the continuation bits
+    static constexpr std::uint32_t layout(std::uint32_t in)
+    {
+      return ((in & 0x7F) | ((in << 1) & 0x7F00) | ((in << 2) & 0x7F0000) |
+              ((in << 3) & 0x7F000000)) |
+        (0x80808000 & std::uint32_t((std::uint64_t(1) << 8*size(in)) - 1));
+    }
+
+    //The encoded bytes, last one in the lowest byte
+    std::uint32_t bytes_;
   };
 
+  //Reads a variable-length number from raw bytes, advancing pos past it.
+  //Returns false if it runs past end or is longer than VARLENGTH_MAX_SIZE.
+  bool readVarLength(const std::uint8_t* & pos, const std::uint8_t* end,
+                     std::uint32_t & value);
+
+  //Bulk versions for arrays of numbers, such as the delta times of a track.
+  //Encoding writes count numbers back to back and returns the end.
+  //Decoding reads count numbers, returning the position after them,
+  //or NULL if they run past end or one is too long.
+  std::uint8_t* encodeVarLengths(const std::uint32_t* values, std::size_t count,
+                                 std::uint8_t* out);
+  const std::uint8_t* decodeVarLengths(const std::uint8_t* pos, const std::uint8_t* end,
+                                       std::uint32_t* values, std::size_t count);
+
 } //Namespace
 
 #endif